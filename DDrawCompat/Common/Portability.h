@@ -0,0 +1,26 @@
+#pragma once
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cstdint>
+
+typedef uint8_t BYTE;
+typedef uint16_t WORD;
+typedef uint32_t DWORD;
+typedef int32_t LONG;
+typedef uint32_t UINT;
+typedef uint16_t UINT16;
+
+struct RGBQUAD
+{
+	BYTE rgbBlue;
+	BYTE rgbGreen;
+	BYTE rgbRed;
+	BYTE rgbReserved;
+};
+#endif
+
+#ifndef _MSC_VER
+#define __forceinline inline __attribute__((always_inline))
+#endif
@@ -40,4 +40,38 @@ namespace Rect
 	{
 		::transform(rect, srcView, dstView);
 	}
+
+	void unite(std::vector<RECT>& rects, const RECT& rect, std::size_t maxCount)
+	{
+		if (IsRectEmpty(&rect))
+		{
+			return;
+		}
+
+		RECT r = rect;
+		auto it = rects.begin();
+		while (it != rects.end())
+		{
+			if (it->left <= r.right && r.left <= it->right && it->top <= r.bottom && r.top <= it->bottom)
+			{
+				UnionRect(&r, &r, &*it);
+				rects.erase(it);
+				it = rects.begin();
+			}
+			else
+			{
+				++it;
+			}
+		}
+		rects.push_back(r);
+
+		if (rects.size() > maxCount)
+		{
+			for (const auto& rc : rects)
+			{
+				UnionRect(&r, &r, &rc);
+			}
+			rects.assign(1, r);
+		}
+	}
 }
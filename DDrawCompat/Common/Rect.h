@@ -1,5 +1,7 @@
 #pragma once
 
+#include <vector>
+
 #include <Windows.h>
 
 struct RectF
@@ -15,4 +17,5 @@ namespace Rect
 	RectF toRectF(const RECT& rect);
 	void transform(RECT& rect, const RECT& srcView, const RECT& dstView);
 	void transform(RectF& rect, const RECT& srcView, const RECT& dstView);
+	void unite(std::vector<RECT>& rects, const RECT& rect, std::size_t maxCount);
 }
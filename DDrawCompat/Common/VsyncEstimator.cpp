@@ -0,0 +1,90 @@
+#include <cmath>
+
+#include <Common/VsyncEstimator.h>
+
+namespace
+{
+	const double PHASE_GAIN = 0.1;
+	const double PERIOD_GAIN = 0.01;
+}
+
+VsyncEstimator::VsyncEstimator()
+{
+	reset();
+}
+
+void VsyncEstimator::addVsync(long long qpc)
+{
+	const double t = static_cast<double>(qpc);
+	if (0 == m_sampleCount)
+	{
+		m_phase = t;
+		m_lastVsync = t;
+		m_sampleCount = 1;
+		return;
+	}
+
+	if (1 == m_sampleCount)
+	{
+		if (t <= m_phase)
+		{
+			reset();
+			addVsync(qpc);
+			return;
+		}
+		m_period = t - m_phase;
+		m_phase = t;
+		m_lastVsync = t;
+		m_sampleCount = 2;
+		return;
+	}
+
+	const double interval = t - m_lastVsync;
+	const double intervalVsyncs = std::round(interval / m_period);
+	m_lastVsync = t;
+
+	const double vsyncs = std::round((t - m_phase) / m_period);
+	const double predicted = m_phase + vsyncs * m_period;
+	const double error = t - predicted;
+	if (intervalVsyncs < 1 || std::abs(interval - intervalVsyncs * m_period) > m_period / 4 ||
+		vsyncs < 1 || std::abs(error) > m_period / 4)
+	{
+		++m_outlierCount;
+		if (m_outlierCount >= MAX_OUTLIERS)
+		{
+			reset();
+			addVsync(qpc);
+		}
+		return;
+	}
+
+	m_outlierCount = 0;
+	m_phase = predicted + PHASE_GAIN * error;
+	m_period += PERIOD_GAIN * error / vsyncs;
+	++m_sampleCount;
+}
+
+long long VsyncEstimator::getNextVsync(long long qpcNow) const
+{
+	if (m_sampleCount < 2)
+	{
+		return 0;
+	}
+
+	const double vsyncs = std::floor((qpcNow - m_phase) / m_period) + 1;
+	return static_cast<long long>(m_phase + vsyncs * m_period);
+}
+
+long long VsyncEstimator::getPeriod() const
+{
+	return m_sampleCount < 2 ? 0 : static_cast<long long>(m_period);
+}
+
+void VsyncEstimator::reset()
+{
+	m_period = 0;
+	m_phase = 0;
+	m_lastVsync = 0;
+	m_sampleCount = 0;
+	m_outlierCount = 0;
+}
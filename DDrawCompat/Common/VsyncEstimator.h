@@ -0,0 +1,24 @@
+#pragma once
+
+#include <Common/Portability.h>
+
+class VsyncEstimator
+{
+public:
+	// Consecutive vsyncs off the estimated timeline that restart the estimation, e.g. after a display mode change
+	static const UINT MAX_OUTLIERS = 4;
+
+	VsyncEstimator();
+
+	void addVsync(long long qpc);
+	long long getNextVsync(long long qpcNow) const;
+	long long getPeriod() const;
+	void reset();
+
+private:
+	double m_period;
+	double m_phase;
+	double m_lastVsync;
+	UINT m_sampleCount;
+	UINT m_outlierCount;
+};
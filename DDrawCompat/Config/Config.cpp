@@ -6,9 +6,12 @@ namespace Config
 	Settings::AlternatePixelCenter alternatePixelCenter;
 	Settings::AltTabFix altTabFix;
 	Settings::Antialiasing antialiasing;
+	Settings::AsyncReadback asyncReadback;
 	Settings::BltFilter bltFilter;
+	Settings::BltThreads bltThreads;
 	Settings::ConfigHotKey configHotKey;
 	Settings::CpuAffinity cpuAffinity;
+	Settings::DdiProfiler ddiProfiler;
 	Settings::DesktopColorDepth desktopColorDepth;
 	Settings::DisplayFilter displayFilter;
 	Settings::DisplayRefreshRate displayRefreshRate;
@@ -17,8 +20,10 @@ namespace Config
 	Settings::FontAntialiasing fontAntialiasing;
 	Settings::ForceD3D9On12 forceD3D9On12;
 	Settings::FpsLimiter fpsLimiter;
+	Settings::FrameStats frameStats;
 	Settings::FullscreenMode fullscreenMode;
 	Settings::LogLevel logLevel;
+	Settings::MemoryBudget memoryBudget;
 	Settings::PalettizedTextures palettizedTextures;
 	Settings::RemoveBorders removeBorders;
 	Settings::RenderColorDepth renderColorDepth;
@@ -4,9 +4,12 @@
 #include <Config/Settings/AlternatePixelCenter.h>
 #include <Config/Settings/AltTabFix.h>
 #include <Config/Settings/Antialiasing.h>
+#include <Config/Settings/AsyncReadback.h>
 #include <Config/Settings/BltFilter.h>
+#include <Config/Settings/BltThreads.h>
 #include <Config/Settings/ConfigHotKey.h>
 #include <Config/Settings/CpuAffinity.h>
+#include <Config/Settings/DdiProfiler.h>
 #include <Config/Settings/DesktopColorDepth.h>
 #include <Config/Settings/DisplayFilter.h>
 #include <Config/Settings/DisplayRefreshRate.h>
@@ -15,8 +18,10 @@
 #include <Config/Settings/FontAntialiasing.h>
 #include <Config/Settings/ForceD3D9On12.h>
 #include <Config/Settings/FpsLimiter.h>
+#include <Config/Settings/FrameStats.h>
 #include <Config/Settings/FullscreenMode.h>
 #include <Config/Settings/LogLevel.h>
+#include <Config/Settings/MemoryBudget.h>
 #include <Config/Settings/PalettizedTextures.h>
 #include <Config/Settings/RemoveBorders.h>
 #include <Config/Settings/RenderColorDepth.h>
@@ -38,9 +43,12 @@ namespace Config
 	extern Settings::AlternatePixelCenter alternatePixelCenter;
 	extern Settings::AltTabFix altTabFix;
 	extern Settings::Antialiasing antialiasing;
+	extern Settings::AsyncReadback asyncReadback;
 	extern Settings::BltFilter bltFilter;
+	extern Settings::BltThreads bltThreads;
 	extern Settings::ConfigHotKey configHotKey;
 	extern Settings::CpuAffinity cpuAffinity;
+	extern Settings::DdiProfiler ddiProfiler;
 	extern Settings::DesktopColorDepth desktopColorDepth;
 	extern Settings::DisplayFilter displayFilter;
 	extern Settings::DisplayRefreshRate displayRefreshRate;
@@ -49,8 +57,10 @@ namespace Config
 	extern Settings::FontAntialiasing fontAntialiasing;
 	extern Settings::ForceD3D9On12 forceD3D9On12;
 	extern Settings::FpsLimiter fpsLimiter;
+	extern Settings::FrameStats frameStats;
 	extern Settings::FullscreenMode fullscreenMode;
 	extern Settings::LogLevel logLevel;
+	extern Settings::MemoryBudget memoryBudget;
 	extern Settings::PalettizedTextures palettizedTextures;
 	extern Settings::RemoveBorders removeBorders;
 	extern Settings::RenderColorDepth renderColorDepth;
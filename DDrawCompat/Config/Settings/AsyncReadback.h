@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Config/EnumSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class AsyncReadback : public EnumSetting
+		{
+		public:
+			enum Value { OFF, ON };
+
+			AsyncReadback()
+				: EnumSetting("AsyncReadback", "on", { "off", "on" })
+			{
+			}
+		};
+	}
+}
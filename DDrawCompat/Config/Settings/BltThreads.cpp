@@ -0,0 +1,21 @@
+#include <Config/Settings/BltThreads.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		BltThreads::BltThreads()
+			: MappedSetting("BltThreads", "off", { {"off", OFF}, {"on", ON} })
+		{
+		}
+
+		Setting::ParamInfo BltThreads::getParamInfo() const
+		{
+			if (ON == m_value)
+			{
+				return { "Threads", 2, 16, 4, m_param };
+			}
+			return {};
+		}
+	}
+}
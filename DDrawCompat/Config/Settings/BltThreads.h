@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Config/MappedSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class BltThreads : public MappedSetting<UINT>
+		{
+		public:
+			static const UINT OFF = 0;
+			static const UINT ON = 1;
+
+			BltThreads();
+
+			virtual ParamInfo getParamInfo() const override;
+		};
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Config/EnumSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class DdiProfiler : public EnumSetting
+		{
+		public:
+			enum Value { OFF, ON };
+
+			DdiProfiler()
+				: EnumSetting("DdiProfiler", "off", { "off", "on" })
+			{
+			}
+		};
+	}
+}
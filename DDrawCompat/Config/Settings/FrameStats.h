@@ -0,0 +1,20 @@
+#pragma once
+
+#include <Config/EnumSetting.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		class FrameStats : public EnumSetting
+		{
+		public:
+			enum Value { OFF, ON, CSV };
+
+			FrameStats()
+				: EnumSetting("FrameStats", "off", { "off", "on", "csv" })
+			{
+			}
+		};
+	}
+}
@@ -0,0 +1,21 @@
+#include <Config/Settings/MemoryBudget.h>
+
+namespace Config
+{
+	namespace Settings
+	{
+		MemoryBudget::MemoryBudget()
+			: MappedSetting("MemoryBudget", "off", { {"off", OFF}, {"on", ON} })
+		{
+		}
+
+		Setting::ParamInfo MemoryBudget::getParamInfo() const
+		{
+			if (ON == m_value)
+			{
+				return { "MB", 64, 4096, 512, m_param };
+			}
+			return {};
+		}
+	}
+}
@@ -1,16 +1,20 @@
 #pragma once
 
-#include <Config/EnumSetting.h>
+#include <Config/MappedSetting.h>
 
 namespace Config
 {
 	namespace Settings
 	{
-		class PalettizedTextures : public MappedSetting<bool>
+		class PalettizedTextures : public MappedSetting<UINT>
 		{
 		public:
+			static const UINT OFF = 0;
+			static const UINT ON = 1;
+			static const UINT CPU = 2;
+
 			PalettizedTextures()
-				: MappedSetting("PalettizedTextures", "on", { {"off", false}, {"on", true} })
+				: MappedSetting("PalettizedTextures", "on", { {"off", OFF}, {"on", ON}, {"cpu", CPU} })
 			{
 			}
 		};
@@ -14,6 +14,17 @@
 
 namespace
 {
+	// Leading part of D3DCAPS9, which can't be included together with the DirectX 7 headers
+	struct D3dCaps9
+	{
+		DWORD unused1[45];
+		DWORD maxPrimitiveCount;
+		DWORD maxVertexIndex;
+		DWORD unused2[29];
+	};
+
+	static_assert(sizeof(D3dCaps9) == 304);
+
 	std::string bitDepthsToString(DWORD bitDepths)
 	{
 		std::string result;
@@ -56,6 +67,13 @@ namespace D3dDdi
 		info.formatOps = getFormatOps();
 		info.supportedZBufferBitDepths = getSupportedZBufferBitDepths(info.formatOps);
 
+		D3dCaps9 d3d9Caps = {};
+		info.maxVertexIndex = 0xFFFF;
+		if (SUCCEEDED(getCaps(D3DDDICAPS_GETD3D9CAPS, d3d9Caps)) && d3d9Caps.maxVertexIndex > info.maxVertexIndex)
+		{
+			info.maxVertexIndex = d3d9Caps.maxVertexIndex;
+		}
+
 		info.isMsaaDepthResolveSupported =
 			info.formatOps.find(FOURCC_RESZ) != info.formatOps.end() &&
 			info.formatOps.find(FOURCC_INTZ) != info.formatOps.end() &&
@@ -63,6 +81,7 @@ namespace D3dDdi
 
 		LOG_INFO << "Supported z-buffer bit depths: " << bitDepthsToString(info.supportedZBufferBitDepths);
 		LOG_INFO << "Supported MSAA modes: " << getSupportedMsaaModes(info.formatOps);
+		LOG_INFO << "Maximum vertex index: " << info.maxVertexIndex;
 		LOG_INFO << "Supported resource formats:";
 		for (const auto& formatOp : info.formatOps)
 		{
@@ -272,7 +291,7 @@ namespace D3dDdi
 			{
 				caps.dwDeviceZBufferBitDepth = getInfo().supportedZBufferBitDepths;
 			}
-			if (Config::palettizedTextures.get())
+			if (Config::Settings::PalettizedTextures::OFF != Config::palettizedTextures.get())
 			{
 				caps.dpcTriCaps.dwTextureCaps |= D3DPTEXTURECAPS_ALPHAPALETTE;
 			}
@@ -281,7 +300,7 @@ namespace D3dDdi
 
 		case D3DDDICAPS_GETFORMATDATA:
 		{
-			if (Config::palettizedTextures.get())
+			if (Config::Settings::PalettizedTextures::OFF != Config::palettizedTextures.get())
 			{
 				UINT count = pData->DataSize / sizeof(FORMATOP);
 				auto formatOp = static_cast<FORMATOP*>(pData->pData);
@@ -10,8 +10,10 @@
 #include <D3dDdi/Adapter.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/DeviceFuncs.h>
+#include <D3dDdi/DeviceFuncsProfiler.h>
 #include <D3dDdi/Resource.h>
 #include <D3dDdi/ScopedCriticalSection.h>
+#include <DDraw/Blitter.h>
 #include <DDraw/ScopedThreadLock.h>
 
 namespace
@@ -106,6 +108,22 @@ namespace D3dDdi
 		return it != m_resources.end() ? it->second.get() : nullptr;
 	}
 
+	void Device::prefetchReadbacks()
+	{
+		auto it = m_readbackResources.begin();
+		while (it != m_readbackResources.end())
+		{
+			if ((*it)->prefetchReadback())
+			{
+				++it;
+			}
+			else
+			{
+				it = m_readbackResources.erase(it);
+			}
+		}
+	}
+
 	void Device::prepareForGpuWrite()
 	{
 		if (m_depthStencil)
@@ -263,6 +281,7 @@ namespace D3dDdi
 		auto device = m_device;
 		auto pfnDestroyDevice = m_origVtable.pfnDestroyDevice;
 		s_devices.erase(device);
+		DeviceFuncsProfiler::dump();
 		return pfnDestroyDevice(device);
 	}
 
@@ -309,6 +328,7 @@ namespace D3dDdi
 			}
 			m_drawPrimitive.removeSysMemVertexBuffer(resource);
 			m_state.onDestroyResource(res, resource);
+			m_readbackResources.erase(res);
 		}
 
 		return result;
@@ -332,6 +352,7 @@ namespace D3dDdi
 			return S_OK;
 		}
 		flushPrimitives();
+		prefetchReadbacks();
 		return m_origVtable.pfnFlush(m_device);
 	}
 
@@ -342,6 +363,7 @@ namespace D3dDdi
 			return S_OK;
 		}
 		flushPrimitives();
+		prefetchReadbacks();
 		return m_origVtable.pfnFlush1(m_device, FlushFlags);
 	}
 
@@ -377,6 +399,11 @@ namespace D3dDdi
 		}
 
 		HRESULT result = m_origVtable.pfnPresent(m_device, &d);
+		m_drawPrimitive.endFrame();
+		m_state.endFrame();
+		prefetchReadbacks();
+		Resource::endFrame();
+		DDraw::Blitter::endFrame();
 		updateAllConfigNow();
 		return result;
 	}
@@ -396,6 +423,11 @@ namespace D3dDdi
 		}
 
 		HRESULT result = m_origVtable.pfnPresent1(m_device, data);
+		m_drawPrimitive.endFrame();
+		m_state.endFrame();
+		prefetchReadbacks();
+		Resource::endFrame();
+		DDraw::Blitter::endFrame();
 		updateAllConfigNow();
 		return result;
 	}
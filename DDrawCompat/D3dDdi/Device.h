@@ -3,6 +3,7 @@
 #include <array>
 #include <map>
 #include <memory>
+#include <set>
 #include <vector>
 
 #include <d3d.h>
@@ -59,6 +60,7 @@ namespace D3dDdi
 		DeviceState& getState() { return m_state; }
 		ShaderBlitter& getShaderBlitter() { return m_shaderBlitter; }
 
+		void addReadbackResource(Resource& resource) { m_readbackResources.insert(&resource); }
 		HRESULT createPrivateResource(D3DDDIARG_CREATERESOURCE2& data);
 		void flushPrimitives() { m_drawPrimitive.flushPrimitives(); }
 		void prepareForGpuWrite();
@@ -78,6 +80,8 @@ namespace D3dDdi
 		static void updateAllConfig();
 
 	private:
+		void prefetchReadbacks();
+
 		static void updateAllConfigNow();
 
 		D3DDDI_DEVICEFUNCS m_origVtable;
@@ -85,6 +89,7 @@ namespace D3dDdi
 		HANDLE m_device;
 		HANDLE m_eventQuery;
 		std::map<HANDLE, std::unique_ptr<Resource>> m_resources;
+		std::set<Resource*> m_readbackResources;
 		Resource* m_depthStencil;
 		Resource* m_renderTarget;
 		UINT m_renderTargetSubResourceIndex;
@@ -1,6 +1,7 @@
 #include <Common/CompatVtable.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/DeviceFuncs.h>
+#include <D3dDdi/DeviceFuncsProfiler.h>
 #include <D3dDdi/ScopedCriticalSection.h>
 #include <D3dDdi/Visitors/DeviceFuncsVisitor.h>
 
@@ -113,6 +114,7 @@ namespace D3dDdi
 		{
 			CompatVtable<D3DDDI_DEVICEFUNCS>::s_origVtable = {};
 			CompatVtable<D3DDDI_DEVICEFUNCS>::hookVtable<ScopedCriticalSection>(vtable, version);
+			DeviceFuncsProfiler::hookVtable(vtable, CompatVtable<D3DDDI_DEVICEFUNCS>::s_origVtable, version);
 		}
 	}
 }
@@ -0,0 +1,243 @@
+#include <algorithm>
+#include <array>
+#include <memory>
+#include <numeric>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+#include <Common/Log.h>
+#include <Common/ScopedCriticalSection.h>
+#include <Common/Time.h>
+#include <Common/VtableSizeVisitor.h>
+#include <Config/Config.h>
+#include <D3dDdi/DeviceFuncsProfiler.h>
+#include <D3dDdi/Visitors/DeviceFuncsVisitor.h>
+
+namespace
+{
+	const UINT MAX_FUNCS = 256;
+
+	static_assert(sizeof(D3DDDI_DEVICEFUNCS) / sizeof(void*) <= MAX_FUNCS, "MAX_FUNCS is too small");
+
+	struct Counters
+	{
+		UINT64 calls;
+		long long totalTime;
+		long long driverTime;
+		long long maxTime;
+	};
+
+	typedef std::array<Counters, MAX_FUNCS> ThreadCounters;
+
+	Compat::CriticalSection g_cs;
+	std::vector<std::string> g_funcNames;
+	std::vector<std::unique_ptr<ThreadCounters>> g_threadCounters;
+	thread_local ThreadCounters* g_counters = nullptr;
+	thread_local long long g_driverTime = 0;
+
+	template <auto memberPtr>
+	using Func = std::remove_reference_t<decltype(std::declval<D3DDDI_DEVICEFUNCS&>().*memberPtr)>;
+
+	template <auto memberPtr>
+	UINT g_funcIndex = 0;
+
+	template <auto memberPtr>
+	Func<memberPtr> g_hookedFunc = nullptr;
+
+	template <auto memberPtr>
+	Func<memberPtr> g_driverFunc = nullptr;
+
+	ThreadCounters& getThreadCounters()
+	{
+		if (!g_counters)
+		{
+			Compat::ScopedCriticalSection lock(g_cs);
+			g_threadCounters.push_back(std::make_unique<ThreadCounters>());
+			g_counters = g_threadCounters.back().get();
+		}
+		return *g_counters;
+	}
+
+	double toMs(long long qpc)
+	{
+		return qpc * 1000.0 / Time::g_qpcFrequency;
+	}
+
+	UINT registerFunc(const char* funcName)
+	{
+		Compat::ScopedCriticalSection lock(g_cs);
+		auto it = std::find(g_funcNames.begin(), g_funcNames.end(), funcName);
+		if (it != g_funcNames.end())
+		{
+			return it - g_funcNames.begin();
+		}
+		g_funcNames.push_back(funcName);
+		return g_funcNames.size() - 1;
+	}
+
+	class DriverTimer
+	{
+	public:
+		DriverTimer() : m_qpcStart(Time::queryPerformanceCounter()) {}
+		~DriverTimer() { g_driverTime += Time::queryPerformanceCounter() - m_qpcStart; }
+
+	private:
+		long long m_qpcStart;
+	};
+
+	class FuncTimer
+	{
+	public:
+		FuncTimer(UINT funcIndex)
+			: m_funcIndex(funcIndex)
+			, m_driverTimeStart(g_driverTime)
+			, m_qpcStart(Time::queryPerformanceCounter())
+		{
+		}
+
+		~FuncTimer()
+		{
+			const long long time = Time::queryPerformanceCounter() - m_qpcStart;
+			auto& counters = getThreadCounters()[m_funcIndex];
+			++counters.calls;
+			counters.totalTime += time;
+			counters.driverTime += g_driverTime - m_driverTimeStart;
+			if (time > counters.maxTime)
+			{
+				counters.maxTime = time;
+			}
+		}
+
+	private:
+		UINT m_funcIndex;
+		long long m_driverTimeStart;
+		long long m_qpcStart;
+	};
+
+	template <auto memberPtr, typename Result, typename... Params>
+	Result APIENTRY profiledDriverFunc(Params... params)
+	{
+		DriverTimer timer;
+		return g_driverFunc<memberPtr>(params...);
+	}
+
+	template <auto memberPtr, typename Result, typename... Params>
+	Result APIENTRY profiledFunc(Params... params)
+	{
+		FuncTimer timer(g_funcIndex<memberPtr>);
+		return g_hookedFunc<memberPtr>(params...);
+	}
+
+	class ProfilerHookVisitor
+	{
+	public:
+		ProfilerHookVisitor(D3DDDI_DEVICEFUNCS& vtable, D3DDDI_DEVICEFUNCS& origVtable)
+			: m_vtable(vtable)
+			, m_origVtable(origVtable)
+		{
+		}
+
+		template <auto memberPtr>
+		void visit(const char* funcName)
+		{
+			auto driverFunc = m_origVtable.*memberPtr;
+			if (!driverFunc)
+			{
+				return;
+			}
+
+			if (g_driverFunc<memberPtr> && g_driverFunc<memberPtr> != driverFunc)
+			{
+				LOG_ONCE("WARN: DdiProfiler only profiles the first display driver");
+				return;
+			}
+
+			const UINT funcIndex = registerFunc(funcName);
+			if (funcIndex >= MAX_FUNCS)
+			{
+				LOG_ONCE("WARN: DdiProfiler function limit reached, not profiling " << funcName);
+				return;
+			}
+
+			auto hookedFunc = m_vtable.*memberPtr;
+			g_funcIndex<memberPtr> = funcIndex;
+			g_driverFunc<memberPtr> = driverFunc;
+			g_hookedFunc<memberPtr> = hookedFunc == driverFunc ? &profiledDriverFunc<memberPtr> : hookedFunc;
+			m_origVtable.*memberPtr = &profiledDriverFunc<memberPtr>;
+			m_vtable.*memberPtr = &profiledFunc<memberPtr>;
+		}
+
+	private:
+		D3DDDI_DEVICEFUNCS& m_vtable;
+		D3DDDI_DEVICEFUNCS& m_origVtable;
+	};
+}
+
+namespace D3dDdi
+{
+	namespace DeviceFuncsProfiler
+	{
+		void dump()
+		{
+			if (Config::Settings::DdiProfiler::ON != Config::ddiProfiler.get())
+			{
+				return;
+			}
+
+			Compat::ScopedCriticalSection lock(g_cs);
+			std::vector<Counters> totals(g_funcNames.size());
+			for (const auto& threadCounters : g_threadCounters)
+			{
+				for (UINT i = 0; i < totals.size(); ++i)
+				{
+					const auto& counters = (*threadCounters)[i];
+					totals[i].calls += counters.calls;
+					totals[i].totalTime += counters.totalTime;
+					totals[i].driverTime += counters.driverTime;
+					totals[i].maxTime = std::max<long long>(totals[i].maxTime, counters.maxTime);
+				}
+			}
+
+			std::vector<UINT> order(totals.size());
+			std::iota(order.begin(), order.end(), 0);
+			std::sort(order.begin(), order.end(), [&](UINT lhs, UINT rhs)
+				{
+					return totals[lhs].totalTime > totals[rhs].totalTime;
+				});
+
+			LOG_INFO << "Device function profile (calls, DDrawCompat ms, driver ms, max ms):";
+			for (UINT i : order)
+			{
+				const auto& counters = totals[i];
+				if (0 != counters.calls)
+				{
+					LOG_INFO << "  " << g_funcNames[i] << ": " << counters.calls
+						<< ", " << toMs(counters.totalTime - counters.driverTime)
+						<< ", " << toMs(counters.driverTime)
+						<< ", " << toMs(counters.maxTime);
+				}
+			}
+		}
+
+		void hookVtable(const D3DDDI_DEVICEFUNCS& vtable, D3DDDI_DEVICEFUNCS& origVtable, UINT version)
+		{
+			if (Config::Settings::DdiProfiler::ON != Config::ddiProfiler.get())
+			{
+				return;
+			}
+
+			VtableSizeVisitor<D3DDDI_DEVICEFUNCS> vtableSizeVisitor;
+			forEach<D3DDDI_DEVICEFUNCS>(vtableSizeVisitor, version);
+			const auto vtableSize = vtableSizeVisitor.getSize();
+
+			DWORD oldProtect = 0;
+			VirtualProtect(const_cast<D3DDDI_DEVICEFUNCS*>(&vtable), vtableSize, PAGE_READWRITE, &oldProtect);
+
+			ProfilerHookVisitor visitor(const_cast<D3DDDI_DEVICEFUNCS&>(vtable), origVtable);
+			forEach<D3DDDI_DEVICEFUNCS>(visitor, version);
+
+			VirtualProtect(const_cast<D3DDDI_DEVICEFUNCS*>(&vtable), vtableSize, oldProtect, &oldProtect);
+		}
+	}
+}
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <d3d.h>
+#include <d3dumddi.h>
+
+namespace D3dDdi
+{
+	namespace DeviceFuncsProfiler
+	{
+		void dump();
+		void hookVtable(const D3DDDI_DEVICEFUNCS& vtable, D3DDDI_DEVICEFUNCS& origVtable, UINT version);
+	}
+}
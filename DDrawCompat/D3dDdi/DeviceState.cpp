@@ -1,4 +1,5 @@
 #include <algorithm>
+#include <string_view>
 
 #include <Config/Config.h>
 #include <Common/Log.h>
@@ -14,6 +15,7 @@
 namespace
 {
 	const HANDLE DELETED_RESOURCE = reinterpret_cast<HANDLE>(0xBAADBAAD);
+	const UINT MAX_SHADER_CONST_GAP = 4;
 }
 
 namespace D3dDdi
@@ -42,11 +44,13 @@ namespace D3dDdi
 		, m_vertexShaderConst{}
 		, m_vertexShaderConstB{}
 		, m_vertexShaderConstI{}
+		, m_vertexDecl(nullptr)
 		, m_changedStates(0)
 		, m_maxChangedTextureStage(0)
 		, m_changedTextureStageStates{}
 		, m_vsVertexFixup(createVertexShader(g_vsVertexFixup))
 		, m_textureResource{}
+		, m_stateStats{}
 		, m_isLocked(false)
 		, m_spriteMode(false)
 	{
@@ -223,6 +227,15 @@ namespace D3dDdi
 		m_maxChangedTextureStage = max(stage, m_maxChangedTextureStage);
 	}
 
+	void DeviceState::endFrame()
+	{
+		LOG_DEBUG << "Render states: " << m_stateStats.appRenderStates << " set, " << m_stateStats.renderStates << " sent; "
+			<< "texture stage states: " << m_stateStats.appTextureStageStates << " set, "
+			<< m_stateStats.textureStageStates << " sent; " << m_stateStats.redundantStates << " redundant skipped; "
+			<< "shader constants: " << m_stateStats.appShaderConsts << " set, " << m_stateStats.shaderConsts << " sent";
+		m_stateStats = {};
+	}
+
 	void DeviceState::flush()
 	{
 		if (0 == m_changedStates || m_isLocked)
@@ -252,6 +265,10 @@ namespace D3dDdi
 		{
 			updateTextureStages();
 		}
+		if (m_changedStates & CS_SHADER_CONST)
+		{
+			updateShaderConsts();
+		}
 
 		m_changedStates = 0;
 		m_maxChangedTextureStage = 0;
@@ -273,8 +290,7 @@ namespace D3dDdi
 	const DeviceState::VertexDecl& DeviceState::getVertexDecl() const
 	{
 		static const VertexDecl emptyDecl = {};
-		auto it = m_vertexShaderDecls.find(m_app.vertexShaderDecl);
-		return it != m_vertexShaderDecls.end() ? it->second : emptyDecl;
+		return m_vertexDecl ? *m_vertexDecl : emptyDecl;
 	}
 
 	UINT DeviceState::mapRsValue(D3DDDIRENDERSTATETYPE state, UINT value)
@@ -374,6 +390,22 @@ namespace D3dDdi
 	{
 		LOG_DEBUG << Compat::array(vertexElements, data->NumVertexElements);
 
+		const UINT size = data->NumVertexElements * sizeof(D3DDDIVERTEXELEMENT);
+		const auto hash = std::hash<std::string_view>()(
+			std::string_view(reinterpret_cast<const char*>(vertexElements), size));
+		auto range = m_vertexShaderDeclsByHash.equal_range(hash);
+		for (auto it = range.first; it != range.second; ++it)
+		{
+			auto& cachedDecl = m_vertexShaderDecls[it->second];
+			if (cachedDecl.decl.elements.size() == data->NumVertexElements &&
+				0 == memcmp(cachedDecl.decl.elements.data(), vertexElements, size))
+			{
+				++cachedDecl.refCount;
+				data->ShaderHandle = it->second;
+				return S_OK;
+			}
+		}
+
 		const UINT D3DDECLUSAGE_POSITION = 0;
 		const UINT D3DDECLUSAGE_TEXCOORD = 5;
 		const UINT D3DDECLUSAGE_POSITIONT = 9;
@@ -403,7 +435,8 @@ namespace D3dDdi
 		HRESULT result = m_device.getOrigVtable().pfnCreateVertexShaderDecl(m_device, data, ve.data());
 		if (SUCCEEDED(result))
 		{
-			m_vertexShaderDecls[data->ShaderHandle] = decl;
+			m_vertexShaderDecls[data->ShaderHandle] = { decl, hash, 1 };
+			m_vertexShaderDeclsByHash.emplace(hash, data->ShaderHandle);
 		}
 		return result;
 	}
@@ -415,10 +448,27 @@ namespace D3dDdi
 
 	HRESULT DeviceState::pfnDeleteVertexShaderDecl(HANDLE shader)
 	{
+		auto it = m_vertexShaderDecls.find(shader);
+		if (it != m_vertexShaderDecls.end() && --it->second.refCount > 0)
+		{
+			return S_OK;
+		}
+
 		HRESULT result = deleteShader(shader, &State::vertexShaderDecl, m_device.getOrigVtable().pfnDeleteVertexShaderDecl);
-		if (SUCCEEDED(result))
+		if (SUCCEEDED(result) && it != m_vertexShaderDecls.end())
 		{
-			m_vertexShaderDecls.erase(shader);
+			auto range = m_vertexShaderDeclsByHash.equal_range(it->second.hash);
+			auto hashIt = std::find_if(range.first, range.second, [&](const auto& pair) { return pair.second == shader; });
+			if (hashIt != range.second)
+			{
+				m_vertexShaderDeclsByHash.erase(hashIt);
+			}
+
+			if (m_vertexDecl == &it->second.decl)
+			{
+				m_vertexDecl = nullptr;
+			}
+			m_vertexShaderDecls.erase(it);
 		}
 		return result;
 	}
@@ -445,7 +495,7 @@ namespace D3dDdi
 
 	HRESULT DeviceState::pfnSetPixelShaderConst(const D3DDDIARG_SETPIXELSHADERCONST* data, const FLOAT* registers)
 	{
-		return setShaderConst(data, registers, m_pixelShaderConst, m_device.getOrigVtable().pfnSetPixelShaderConst);
+		return deferShaderConst(data, registers, m_pixelShaderConst, m_pixelShaderConstMask);
 	}
 
 	HRESULT DeviceState::pfnSetPixelShaderConstB(const D3DDDIARG_SETPIXELSHADERCONSTB* data, const BOOL* registers)
@@ -462,6 +512,7 @@ namespace D3dDdi
 	{
 		m_app.renderState[data->State] = data->Value;
 		m_changedRenderStates.set(data->State);
+		++m_stateStats.appRenderStates;
 		m_changedStates |= CS_RENDER_STATE;
 		return S_OK;
 	}
@@ -505,6 +556,7 @@ namespace D3dDdi
 
 	HRESULT DeviceState::pfnSetTextureStageState(const D3DDDIARG_TEXTURESTAGESTATE* data)
 	{
+		++m_stateStats.appTextureStageStates;
 		if (D3DTSS_ADDRESS == data->State)
 		{
 			m_app.textureStageState[data->Stage][D3DDDITSS_ADDRESSU] = data->Value;
@@ -534,7 +586,7 @@ namespace D3dDdi
 
 	HRESULT DeviceState::pfnSetVertexShaderConst(const D3DDDIARG_SETVERTEXSHADERCONST* data, const void* registers)
 	{
-		return setShaderConst(data, registers, m_vertexShaderConst, m_device.getOrigVtable().pfnSetVertexShaderConst);
+		return deferShaderConst(data, registers, m_vertexShaderConst, m_vertexShaderConstMask);
 	}
 
 	HRESULT DeviceState::pfnSetVertexShaderConstB(const D3DDDIARG_SETVERTEXSHADERCONSTB* data, const BOOL* registers)
@@ -550,6 +602,8 @@ namespace D3dDdi
 	HRESULT DeviceState::pfnSetVertexShaderDecl(HANDLE shader)
 	{
 		m_app.vertexShaderDecl = shader;
+		auto it = m_vertexShaderDecls.find(shader);
+		m_vertexDecl = it != m_vertexShaderDecls.end() ? &it->second.decl : nullptr;
 		m_changedStates |= CS_SHADER;
 		return S_OK;
 	}
@@ -644,11 +698,13 @@ namespace D3dDdi
 	{
 		if (renderState.Value == m_current.renderState[renderState.State])
 		{
+			++m_stateStats.redundantStates;
 			return;
 		}
 
 		m_device.flushPrimitives();
 		m_device.getOrigVtable().pfnSetRenderState(m_device, &renderState);
+		++m_stateStats.renderStates;
 		m_current.renderState[renderState.State] = renderState.Value;
 		LOG_DS << renderState;
 	}
@@ -833,7 +889,7 @@ namespace D3dDdi
 
 				if (0 != memcmp(&reg, &m_vertexShaderConst[data.Register], sizeof(reg)))
 				{
-					pfnSetVertexShaderConst(&data, &reg);
+					setShaderConst(&data, &reg, m_vertexShaderConst, m_device.getOrigVtable().pfnSetVertexShaderConst);
 				}
 			}
 		}
@@ -846,11 +902,13 @@ namespace D3dDdi
 	{
 		if (tss.Value == m_current.textureStageState[tss.Stage][tss.State])
 		{
+			++m_stateStats.redundantStates;
 			return;
 		}
 
 		m_device.flushPrimitives();
 		m_device.getOrigVtable().pfnSetTextureStageState(m_device, &tss);
+		++m_stateStats.textureStageStates;
 		m_current.textureStageState[tss.Stage][tss.State] = tss.Value;
 		LOG_DS << tss;
 	}
@@ -899,6 +957,25 @@ namespace D3dDdi
 		return false;
 	}
 
+	template <typename SetShaderConstData, typename ShaderConstArray, typename Register>
+	HRESULT DeviceState::deferShaderConst(const SetShaderConstData* data, const Register* registers,
+		ShaderConstArray& shaderConstArray, ShaderConstMask& dirtyMask)
+	{
+		if (0 == data->Count)
+		{
+			return S_OK;
+		}
+
+		memcpy(&shaderConstArray[data->Register], registers, data->Count * sizeof(ShaderConstArray::value_type));
+		for (UINT i = data->Register; i < data->Register + data->Count; ++i)
+		{
+			dirtyMask.set(i);
+		}
+		m_changedStates |= CS_SHADER_CONST;
+		++m_stateStats.appShaderConsts;
+		return S_OK;
+	}
+
 	template <typename SetShaderConstData, typename ShaderConstArray, typename Register>
 	HRESULT DeviceState::setShaderConst(const SetShaderConstData* data, const Register* registers,
 		ShaderConstArray& shaderConstArray,
@@ -974,12 +1051,53 @@ namespace D3dDdi
 		updateVertexFixupConstants();
 	}
 
+	void DeviceState::updateShaderConsts()
+	{
+		updateShaderConst(m_pixelShaderConst, m_pixelShaderConstMask,
+			m_device.getOrigVtable().pfnSetPixelShaderConst);
+		updateShaderConst(m_vertexShaderConst, m_vertexShaderConstMask,
+			m_device.getOrigVtable().pfnSetVertexShaderConst);
+	}
+
+	template <typename SetShaderConstData, typename ShaderConstArray, typename Register>
+	void DeviceState::updateShaderConst(ShaderConstArray& shaderConstArray, ShaderConstMask& dirtyMask,
+		HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*))
+	{
+		SetShaderConstData data = {};
+		auto flushRun = [&]()
+			{
+				if (0 != data.Count)
+				{
+					m_device.flushPrimitives();
+					origSetShaderConstFunc(m_device, &data, &shaderConstArray[data.Register][0]);
+					++m_stateStats.shaderConsts;
+					LOG_DS << data;
+				}
+			};
+
+		// Runs separated by only a few clean registers are sent together, which is cheaper than another call
+		dirtyMask.forEach([&](UINT reg)
+			{
+				if (0 != data.Count && reg - (data.Register + data.Count) > MAX_SHADER_CONST_GAP)
+				{
+					flushRun();
+					data.Count = 0;
+				}
+				if (0 == data.Count)
+				{
+					data.Register = reg;
+				}
+				data.Count = reg + 1 - data.Register;
+			});
+		flushRun();
+		dirtyMask.reset();
+	}
+
 	void DeviceState::updateShaders()
 	{
 		setPixelShader(m_app.pixelShader);
 		setVertexShaderDecl(m_app.vertexShaderDecl);
-		auto it = m_vertexShaderDecls.find(m_app.vertexShaderDecl);
-		if (it != m_vertexShaderDecls.end() && it->second.isTransformed)
+		if (getVertexDecl().isTransformed)
 		{
 			setVertexShaderFunc(m_vsVertexFixup.get());
 		}
@@ -1001,7 +1119,7 @@ namespace D3dDdi
 		}
 	}
 
-	void DeviceState::updateTextureColorKey(UINT stage)
+	void DeviceState::updateTextureColorKey(UINT stage, bool isTextureChanged)
 	{
 		m_changedTextureStageStates[stage].reset(D3DDDITSS_DISABLETEXTURECOLORKEY);
 		m_changedTextureStageStates[stage].reset(D3DDDITSS_TEXTURECOLORKEYVAL);
@@ -1013,11 +1131,16 @@ namespace D3dDdi
 		D3DDDIARG_TEXTURESTAGESTATE tss = {};
 		tss.Stage = stage;
 
+		auto& currentTss = m_current.textureStageState[stage];
 		if (m_app.textureStageState[stage][D3DDDITSS_DISABLETEXTURECOLORKEY])
 		{
 			tss.State = D3DDDITSS_DISABLETEXTURECOLORKEY;
 			tss.Value = m_app.textureStageState[stage][D3DDDITSS_DISABLETEXTURECOLORKEY];
-			m_current.textureStageState[stage][D3DDDITSS_DISABLETEXTURECOLORKEY] = tss.Value;
+			if (!isTextureChanged && tss.Value == currentTss[D3DDDITSS_DISABLETEXTURECOLORKEY])
+			{
+				return;
+			}
+			currentTss[D3DDDITSS_DISABLETEXTURECOLORKEY] = tss.Value;
 		}
 		else
 		{
@@ -1029,8 +1152,13 @@ namespace D3dDdi
 				tss.Value = reinterpret_cast<DWORD&>(
 					m_device.getPalette(resource->getPalettizedTexture()->getPaletteHandle())[tss.Value]);
 			}
-			m_current.textureStageState[stage][D3DDDITSS_TEXTURECOLORKEYVAL] = tss.Value;
-			m_current.textureStageState[stage][D3DDDITSS_DISABLETEXTURECOLORKEY] = FALSE;
+			if (!isTextureChanged && !currentTss[D3DDDITSS_DISABLETEXTURECOLORKEY] &&
+				tss.Value == currentTss[D3DDDITSS_TEXTURECOLORKEYVAL])
+			{
+				return;
+			}
+			currentTss[D3DDDITSS_TEXTURECOLORKEYVAL] = tss.Value;
+			currentTss[D3DDDITSS_DISABLETEXTURECOLORKEY] = FALSE;
 		}
 
 		m_device.flushPrimitives();
@@ -1042,11 +1170,12 @@ namespace D3dDdi
 	{
 		for (UINT stage = 0; stage <= m_maxChangedTextureStage; ++stage)
 		{
-			if (setTexture(stage, m_app.textures[stage]) ||
+			const bool isTextureChanged = setTexture(stage, m_app.textures[stage]);
+			if (isTextureChanged ||
 				m_changedTextureStageStates[stage].test(D3DDDITSS_DISABLETEXTURECOLORKEY) ||
 				m_changedTextureStageStates[stage].test(D3DDDITSS_TEXTURECOLORKEYVAL))
 			{
-				updateTextureColorKey(stage);
+				updateTextureColorKey(stage, isTextureChanged);
 			}
 
 			m_changedTextureStageStates[stage].forEach([&](UINT stateIndex)
@@ -1079,7 +1208,7 @@ namespace D3dDdi
 
 		if (0 != memcmp(registers, &m_vertexShaderConst[data.Register], sizeof(registers)))
 		{
-			pfnSetVertexShaderConst(&data, registers);
+			setShaderConst(&data, registers, m_vertexShaderConst, m_device.getOrigVtable().pfnSetVertexShaderConst);
 		}
 	}
 }
@@ -4,8 +4,8 @@
 #include <d3dumddi.h>
 
 #include <array>
-#include <map>
 #include <memory>
+#include <unordered_map>
 #include <vector>
 
 #include <Common/BitSet.h>
@@ -27,6 +27,7 @@ namespace D3dDdi
 		typedef std::array<BOOL, 1> ShaderConstB;
 		typedef std::array<FLOAT, 4> ShaderConstF;
 		typedef std::array<INT, 4> ShaderConstI;
+		typedef BitSet<0, 255> ShaderConstMask;
 
 		struct State
 		{
@@ -125,6 +126,7 @@ namespace D3dDdi
 		void setTempZRange(const D3DDDIARG_ZRANGE& zRange);
 
 		void disableTextureClamp(UINT stage);
+		void endFrame();
 		void flush();
 		const State& getAppState() const { return m_app; }
 		const State& getCurrentState() const { return m_current; }
@@ -145,7 +147,26 @@ namespace D3dDdi
 			CS_RENDER_TARGET = 1 << 1,
 			CS_SHADER        = 1 << 2,
 			CS_STREAM_SOURCE = 1 << 3,
-			CS_TEXTURE_STAGE = 1 << 4
+			CS_TEXTURE_STAGE = 1 << 4,
+			CS_SHADER_CONST  = 1 << 5
+		};
+
+		struct CachedVertexDecl
+		{
+			VertexDecl decl;
+			std::size_t hash;
+			UINT refCount;
+		};
+
+		struct StateStats
+		{
+			UINT appRenderStates;
+			UINT appTextureStageStates;
+			UINT renderStates;
+			UINT textureStageStates;
+			UINT redundantStates;
+			UINT appShaderConsts;
+			UINT shaderConsts;
 		};
 
 		template <int N>
@@ -155,6 +176,9 @@ namespace D3dDdi
 		}
 
 		std::unique_ptr<void, ResourceDeleter> DeviceState::createVertexShader(const BYTE* code, UINT size);
+		template <typename SetShaderConstData, typename ShaderConstArray, typename Register>
+		HRESULT deferShaderConst(const SetShaderConstData* data, const Register* registers,
+			ShaderConstArray& shaderConstArray, ShaderConstMask& dirtyMask);
 		HRESULT deleteShader(HANDLE shader, HANDLE State::* shaderMember,
 			HRESULT(APIENTRY* origDeleteShaderFunc)(HANDLE, HANDLE));
 
@@ -192,8 +216,14 @@ namespace D3dDdi
 
 		void updateRenderStates();
 		void updateRenderTarget();
+		void updateShaderConsts();
+
+		template <typename SetShaderConstData, typename ShaderConstArray, typename Register>
+		void updateShaderConst(ShaderConstArray& shaderConstArray, ShaderConstMask& dirtyMask,
+			HRESULT(APIENTRY* origSetShaderConstFunc)(HANDLE, const SetShaderConstData*, const Register*));
+
 		void updateShaders();
-		void updateTextureColorKey(UINT stage);
+		void updateTextureColorKey(UINT stage, bool isTextureChanged);
 		void updateTextureStages();
 		void updateVertexFixupConstants();
 
@@ -206,7 +236,11 @@ namespace D3dDdi
 		std::array<ShaderConstF, 256> m_vertexShaderConst;
 		std::array<ShaderConstB, 16> m_vertexShaderConstB;
 		std::array<ShaderConstI, 16> m_vertexShaderConstI;
-		std::map<HANDLE, VertexDecl> m_vertexShaderDecls;
+		ShaderConstMask m_pixelShaderConstMask;
+		ShaderConstMask m_vertexShaderConstMask;
+		std::unordered_map<HANDLE, CachedVertexDecl> m_vertexShaderDecls;
+		std::unordered_multimap<std::size_t, HANDLE> m_vertexShaderDeclsByHash;
+		const VertexDecl* m_vertexDecl;
 		UINT m_changedStates;
 		UINT m_maxChangedTextureStage;
 		UINT m_usedTextureStages;
@@ -214,6 +248,7 @@ namespace D3dDdi
 		std::array<BitSet<D3DDDITSS_TEXTUREMAP, D3DDDITSS_TEXTURECOLORKEYVAL>, 8> m_changedTextureStageStates;
 		std::unique_ptr<void, ResourceDeleter> m_vsVertexFixup;
 		std::array<Resource*, 8> m_textureResource;
+		StateStats m_stateStats;
 		bool m_isLocked;
 		bool m_spriteMode;
 	};
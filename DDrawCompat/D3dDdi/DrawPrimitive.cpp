@@ -1,15 +1,31 @@
 #include <algorithm>
+#include <cstddef>
+#include <limits>
 
 #include <Common/Log.h>
 #include <Config/Config.h>
+#include <D3dDdi/Adapter.h>
 #include <D3dDdi/DrawPrimitive.h>
 #include <D3dDdi/Device.h>
+#include <D3dDdi/IndexKernels.h>
 #include <D3dDdi/Resource.h>
+#include <D3dDdi/SpriteKernels.h>
 
 namespace
 {
 	const UINT INDEX_BUFFER_SIZE = D3DMAXNUMPRIMITIVES * 3 * sizeof(UINT16);
 	const UINT VERTEX_BUFFER_SIZE = 1024 * 1024;
+	const UINT MAX_STRIP_JOIN_VERTICES = 3;
+
+	// Mixed batches with more sprite/non-sprite runs than this keep the mode of their first triangle
+	const UINT MAX_SPRITE_RUNS = 8;
+
+	float getSpriteMaxZ()
+	{
+		return Config::Settings::SpriteDetection::ZMAX == Config::spriteDetection.get()
+			? static_cast<float>(Config::spriteDetection.getParam()) / 100
+			: std::numeric_limits<float>::infinity();
+	}
 
 	UINT getVertexCount(D3DPRIMITIVETYPE primitiveType, UINT primitiveCount)
 	{
@@ -56,16 +72,16 @@ namespace D3dDdi
 		, m_indexBuffer(device, m_vertexBuffer ? INDEX_BUFFER_SIZE : 0)
 		, m_streamSource{}
 		, m_batched{}
+		, m_maxVertexIndex(device.getAdapter().getInfo().maxVertexIndex)
+		, m_drawsIn(0)
+		, m_drawsOut(0)
 	{
 		LOG_ONCE("Dynamic vertex buffers are " << (m_vertexBuffer ? "" : "not ") << "available");
 		LOG_ONCE("Dynamic index buffers are " << (m_indexBuffer ? "" : "not ") << "available");
 
 		if (m_indexBuffer)
 		{
-			D3DDDIARG_SETINDICES si = {};
-			si.hIndexBuffer = m_indexBuffer;
-			si.Stride = 2;
-			m_origVtable.pfnSetIndices(m_device, &si);
+			setIndices();
 		}
 	}
 
@@ -90,13 +106,13 @@ namespace D3dDdi
 			INT delta = getBatchedVertexCount() - minIndex;
 			for (UINT i = 0; i < count; ++i)
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(indices[i] + delta));
+				m_batched.indices.push_back(static_cast<UINT>(indices[i] + delta));
 			}
 			appendVertices(baseVertexIndex + minIndex, vertexCount);
 			return;
 		}
 
-		static UINT16 indexMap[D3DMAXNUMVERTICES] = {};
+		static UINT indexMap[D3DMAXNUMVERTICES] = {};
 		static BYTE indexCycles[D3DMAXNUMVERTICES] = {};
 		static BYTE currentCycle = 0;
 		static UINT maxVertexCount = 0;
@@ -113,7 +129,7 @@ namespace D3dDdi
 			updateMax(maxVertexCount, vertexCount);
 		}
 
-		UINT16 newIndex = static_cast<UINT16>(getBatchedVertexCount());
+		UINT newIndex = getBatchedVertexCount();
 		for (UINT i = 0; i < count; ++i)
 		{
 			const UINT16 zeroBasedIndex = static_cast<UINT16>(indices[i] - minIndex);
@@ -142,7 +158,7 @@ namespace D3dDdi
 	{
 		for (UINT i = base; i < base + count; ++i)
 		{
-			m_batched.indices.push_back(static_cast<UINT16>(i));
+			m_batched.indices.push_back(i);
 		}
 		updateMin(m_batched.minIndex, base);
 		updateMax(m_batched.maxIndex, base + count - 1);
@@ -154,7 +170,7 @@ namespace D3dDdi
 		rebaseIndices();
 		for (UINT i = 0; i < count; ++i)
 		{
-			m_batched.indices.push_back(static_cast<UINT16>(baseVertexIndex + indices[i]));
+			m_batched.indices.push_back(static_cast<UINT>(baseVertexIndex + indices[i]));
 		}
 		updateMin(m_batched.minIndex, baseVertexIndex + minIndex);
 		updateMax(m_batched.maxIndex, baseVertexIndex + maxIndex);
@@ -203,7 +219,8 @@ namespace D3dDdi
 	bool DrawPrimitive::appendPrimitives(D3DPRIMITIVETYPE primitiveType, INT baseVertexIndex, UINT primitiveCount,
 		const UINT16* indices, UINT minIndex, UINT maxIndex)
 	{
-		if (m_batched.primitiveCount + primitiveCount > D3DMAXNUMPRIMITIVES)
+		if (m_batched.primitiveCount + primitiveCount > D3DMAXNUMPRIMITIVES ||
+			!isIndexRangeSupported(primitiveType, baseVertexIndex, primitiveCount, indices ? maxIndex : UINT_MAX))
 		{
 			return false;
 		}
@@ -304,15 +321,15 @@ namespace D3dDdi
 		{
 			if (m_streamSource.vertices)
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(getBatchedVertexCount()));
+				m_batched.indices.push_back(getBatchedVertexCount());
 			}
 			else if (indices)
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(baseVertexIndex + indices[0]));
+				m_batched.indices.push_back(static_cast<UINT>(baseVertexIndex + indices[0]));
 			}
 			else
 			{
-				m_batched.indices.push_back(static_cast<UINT16>(baseVertexIndex));
+				m_batched.indices.push_back(static_cast<UINT>(baseVertexIndex));
 			}
 		}
 		m_batched.primitiveCount += 3;
@@ -322,69 +339,139 @@ namespace D3dDdi
 
 	void DrawPrimitive::appendVertices(UINT base, UINT count)
 	{
-		auto vertices = m_streamSource.vertices + base * m_streamSource.stride;
-		m_batched.vertices.insert(m_batched.vertices.end(), vertices, vertices + count * m_streamSource.stride);
+		writeBatchedVertices(m_streamSource.vertices + base * m_streamSource.stride, count);
 	}
 
-	void DrawPrimitive::clearBatchedPrimitives()
+	void DrawPrimitive::batchIndexedPrimitives(const D3DDDIARG_DRAWINDEXEDPRIMITIVE2& data, INT vStart,
+		const UINT16* indices, const UINT* flagBuffer)
 	{
-		m_batched.primitiveCount = 0;
-		m_batched.vertices.clear();
-		m_batched.indices.clear();
+		const UINT indexCount = getVertexCount(data.PrimitiveType, data.PrimitiveCount);
+		auto [min, max] = std::minmax_element(indices, indices + indexCount);
+
+		if (0 == m_batched.primitiveCount || flagBuffer || !hasVertexStreamCapacity(indexCount) ||
+			!appendPrimitives(data.PrimitiveType, vStart, data.PrimitiveCount, indices, *min, *max))
+		{
+			flushPrimitives();
+			m_batched.baseVertexIndex = vStart;
+			if (m_streamSource.vertices)
+			{
+				beginVertexStream(indexCount);
+				appendIndexedVerticesWithoutRebase(indices, indexCount, m_batched.baseVertexIndex, *min, *max);
+				m_batched.baseVertexIndex = 0;
+			}
+			else
+			{
+				m_batched.indices.assign(indices, indices + indexCount);
+				m_batched.minIndex = *min;
+				m_batched.maxIndex = *max;
+			}
+			m_batched.primitiveType = data.PrimitiveType;
+			m_batched.primitiveCount = data.PrimitiveCount;
+
+			if (flagBuffer)
+			{
+				flushPrimitives(flagBuffer);
+			}
+		}
 	}
 
-	void DrawPrimitive::convertIndexedTriangleFanToList(UINT startPrimitive, UINT primitiveCount)
+	void DrawPrimitive::batchPrimitives(const D3DDDIARG_DRAWPRIMITIVE& data, const UINT* flagBuffer)
 	{
-		const UINT totalPrimitiveCount = startPrimitive + primitiveCount;
-		m_batched.indices.resize(totalPrimitiveCount * 3);
+		const UINT vertexCount = getVertexCount(data.PrimitiveType, data.PrimitiveCount);
+		if (0 == m_batched.primitiveCount || flagBuffer || !hasVertexStreamCapacity(vertexCount) ||
+			!appendPrimitives(data.PrimitiveType, data.VStart, data.PrimitiveCount, nullptr, 0, 0))
+		{
+			flushPrimitives();
+			if (m_streamSource.vertices)
+			{
+				beginVertexStream(vertexCount);
+				appendVertices(data.VStart, vertexCount);
+				m_batched.baseVertexIndex = 0;
+			}
+			else
+			{
+				m_batched.baseVertexIndex = data.VStart;
+				m_batched.minIndex = D3DMAXNUMVERTICES;
+				m_batched.maxIndex = 0;
+			}
+			m_batched.primitiveType = data.PrimitiveType;
+			m_batched.primitiveCount = data.PrimitiveCount;
+
+			if (flagBuffer)
+			{
+				flushPrimitives(flagBuffer);
+			}
+		}
+	}
 
-		INT startIndexPos = startPrimitive * 3;
-		INT oldIndexPos = startIndexPos + primitiveCount - 1;
-		INT newIndexPos = (totalPrimitiveCount - 1) * 3;
-		const UINT16 startIndex = m_batched.indices[startIndexPos];
+	void DrawPrimitive::beginVertexStream(UINT count)
+	{
+		const UINT size = (count + MAX_STRIP_JOIN_VERTICES) * m_streamSource.stride;
+		if (!m_vertexBuffer || size > m_vertexBuffer.getSize())
+		{
+			return;
+		}
 
-		while (newIndexPos > startIndexPos)
+		HANDLE prevVertexBuffer = m_vertexBuffer;
+		m_batched.streamedVertices = static_cast<BYTE*>(m_vertexBuffer.lockStream(size));
+		if (m_vertexBuffer != prevVertexBuffer)
 		{
-			m_batched.indices[newIndexPos + 2] = startIndex;
-			m_batched.indices[newIndexPos + 1] = m_batched.indices[oldIndexPos + 2];
-			m_batched.indices[newIndexPos] = m_batched.indices[oldIndexPos + 1];
-			newIndexPos -= 3;
-			oldIndexPos--;
+			setVertexBuffer();
 		}
 
-		m_batched.indices[newIndexPos] = m_batched.indices[oldIndexPos + 1];
-		m_batched.indices[newIndexPos + 1] = m_batched.indices[oldIndexPos + 2];
-		m_batched.indices[newIndexPos + 2] = startIndex;
+		if (m_batched.streamedVertices)
+		{
+			m_batched.streamCapacity = m_vertexBuffer.getStreamCapacity() / m_streamSource.stride;
+		}
 	}
 
-	void DrawPrimitive::convertIndexedTriangleStripToList(UINT startPrimitive, UINT primitiveCount)
+	bool DrawPrimitive::classifySprites(INT baseVertexIndex, const UINT16* indices, UINT primitiveCount)
 	{
-		const UINT totalPrimitiveCount = startPrimitive + primitiveCount;
-		m_batched.indices.resize(totalPrimitiveCount * 3);
-
-		INT oldIndexPos = startPrimitive * 3 + primitiveCount - 2;
-		INT newIndexPos = (totalPrimitiveCount - 2) * 3;
-
-		if (0 != primitiveCount % 2)
+		if (primitiveCount < 2 || !isSpriteDetectionEnabled())
 		{
-			m_batched.indices[newIndexPos + 5] = m_batched.indices[oldIndexPos + 3];
-			m_batched.indices[newIndexPos + 4] = m_batched.indices[oldIndexPos + 2];
-			m_batched.indices[newIndexPos + 3] = m_batched.indices[oldIndexPos + 1];
-			newIndexPos -= 3;
-			oldIndexPos--;
+			return false;
 		}
 
-		while (newIndexPos >= oldIndexPos)
+		m_spriteMask.resize(SpriteKernels::getMaskSize(primitiveCount));
+		SpriteKernels::classifySprites(m_spriteMask.data(),
+			m_streamSource.vertices + baseVertexIndex * m_streamSource.stride + offsetof(D3DTLVERTEX, sz),
+			m_streamSource.stride, indices, primitiveCount, getSpriteMaxZ());
+
+		UINT runCount = 0;
+		for (UINT first = 0; first < primitiveCount && runCount <= MAX_SPRITE_RUNS;
+			first = SpriteKernels::getRunEnd(m_spriteMask.data(), first, primitiveCount))
 		{
-			m_batched.indices[newIndexPos + 5] = m_batched.indices[oldIndexPos + 2];
-			m_batched.indices[newIndexPos + 4] = m_batched.indices[oldIndexPos + 3];
-			m_batched.indices[newIndexPos + 3] = m_batched.indices[oldIndexPos + 1];
-			m_batched.indices[newIndexPos + 2] = m_batched.indices[oldIndexPos + 2];
-			m_batched.indices[newIndexPos + 1] = m_batched.indices[oldIndexPos + 1];
-			m_batched.indices[newIndexPos] = m_batched.indices[oldIndexPos];
-			newIndexPos -= 6;
-			oldIndexPos -= 2;
+			++runCount;
 		}
+		return runCount > 1 && runCount <= MAX_SPRITE_RUNS;
+	}
+
+	void DrawPrimitive::clearBatchedPrimitives()
+	{
+		m_batched.primitiveCount = 0;
+		m_batched.vertexCount = 0;
+		m_batched.streamedVertices = nullptr;
+		m_batched.streamCapacity = 0;
+		m_batched.vertices.clear();
+		m_batched.indices.clear();
+	}
+
+	void DrawPrimitive::convertIndexedTriangleFanToList(UINT startPrimitive, UINT primitiveCount)
+	{
+		const UINT startIndexPos = startPrimitive * 3;
+		m_convertedIndices.assign(m_batched.indices.begin() + startIndexPos,
+			m_batched.indices.begin() + startIndexPos + primitiveCount + 2);
+		m_batched.indices.resize((startPrimitive + primitiveCount) * 3);
+		IndexKernels::convertTriangleFanToList(m_batched.indices.data() + startIndexPos, m_convertedIndices.data(), primitiveCount);
+	}
+
+	void DrawPrimitive::convertIndexedTriangleStripToList(UINT startPrimitive, UINT primitiveCount)
+	{
+		const UINT startIndexPos = startPrimitive * 3;
+		m_convertedIndices.assign(m_batched.indices.begin() + startIndexPos,
+			m_batched.indices.begin() + startIndexPos + primitiveCount + 2);
+		m_batched.indices.resize((startPrimitive + primitiveCount) * 3);
+		IndexKernels::convertTriangleStripToList(m_batched.indices.data() + startIndexPos, m_convertedIndices.data(), primitiveCount);
 	}
 
 	void DrawPrimitive::convertToTriangleList()
@@ -404,23 +491,8 @@ namespace D3dDdi
 			}
 			else
 			{
-				const UINT baseVertexIndex = static_cast<UINT>(m_batched.baseVertexIndex);
-				UINT i = baseVertexIndex;
-				for (; i < baseVertexIndex + m_batched.primitiveCount - 1; i += 2)
-				{
-					m_batched.indices.push_back(static_cast<UINT16>(i));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 3));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
-				}
-				if (i < baseVertexIndex + m_batched.primitiveCount)
-				{
-					m_batched.indices.push_back(static_cast<UINT16>(i));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
-				}
+				m_batched.indices.resize(m_batched.primitiveCount * 3);
+				IndexKernels::generateTriangleStripList(m_batched.indices.data(), m_batched.baseVertexIndex, m_batched.primitiveCount);
 			}
 			break;
 
@@ -432,12 +504,8 @@ namespace D3dDdi
 			}
 			else
 			{
-				for (UINT i = m_batched.baseVertexIndex; i < m_batched.baseVertexIndex + m_batched.primitiveCount; ++i)
-				{
-					m_batched.indices.push_back(static_cast<UINT16>(i + 1));
-					m_batched.indices.push_back(static_cast<UINT16>(i + 2));
-					m_batched.indices.push_back(static_cast<UINT16>(m_batched.baseVertexIndex));
-				}
+				m_batched.indices.resize(m_batched.primitiveCount * 3);
+				IndexKernels::generateTriangleFanList(m_batched.indices.data(), m_batched.baseVertexIndex, m_batched.primitiveCount);
 			}
 			break;
 		}
@@ -453,6 +521,7 @@ namespace D3dDdi
 
 	HRESULT DrawPrimitive::draw(D3DDDIARG_DRAWPRIMITIVE data, const UINT* flagBuffer)
 	{
+		++m_drawsIn;
 		auto& state = m_device.getState();
 		auto vertexCount = getVertexCount(data.PrimitiveType, data.PrimitiveCount);
 		if (!state.isLocked())
@@ -460,12 +529,23 @@ namespace D3dDdi
 			state.updateStreamSource();
 			if (m_streamSource.vertices && data.PrimitiveType >= D3DPT_TRIANGLELIST)
 			{
-				bool spriteMode = isSprite(data.VStart, 0, 1, 2);
-				state.setSpriteMode(spriteMode);
-				if (spriteMode)
+				if (D3DPT_TRIANGLELIST == data.PrimitiveType && !flagBuffer &&
+					classifySprites(data.VStart, nullptr, data.PrimitiveCount))
 				{
-					setTextureClampMode(data.VStart, nullptr, vertexCount);
+					SpriteKernels::forEachRun(m_spriteMask.data(), data.PrimitiveCount,
+						[&](UINT first, UINT end, bool spriteMode)
+						{
+							D3DDDIARG_DRAWPRIMITIVE run = data;
+							run.VStart += first * 3;
+							run.PrimitiveCount = end - first;
+							setSpriteMode(run.VStart, nullptr, run.PrimitiveCount * 3, spriteMode);
+							m_device.prepareForGpuWrite();
+							state.flush();
+							batchPrimitives(run, nullptr);
+						});
+					return S_OK;
 				}
+				setSpriteMode(data.VStart, nullptr, vertexCount, isSprite(data.VStart, 0, 1, 2));
 			}
 			else
 			{
@@ -475,36 +555,14 @@ namespace D3dDdi
 			state.flush();
 		}
 
-		if (0 == m_batched.primitiveCount || flagBuffer ||
-			!appendPrimitives(data.PrimitiveType, data.VStart, data.PrimitiveCount, nullptr, 0, 0))
-		{
-			flushPrimitives();
-			if (m_streamSource.vertices)
-			{
-				appendVertices(data.VStart, vertexCount);
-				m_batched.baseVertexIndex = 0;
-			}
-			else
-			{
-				m_batched.baseVertexIndex = data.VStart;
-				m_batched.minIndex = D3DMAXNUMVERTICES;
-				m_batched.maxIndex = 0;
-			}
-			m_batched.primitiveType = data.PrimitiveType;
-			m_batched.primitiveCount = data.PrimitiveCount;
-
-			if (flagBuffer)
-			{
-				flushPrimitives(flagBuffer);
-			}
-		}
-
+		batchPrimitives(data, flagBuffer);
 		return S_OK;
 	}
 
 	HRESULT DrawPrimitive::drawIndexed(
 		D3DDDIARG_DRAWINDEXEDPRIMITIVE2 data, const UINT16* indices, const UINT* flagBuffer)
 	{
+		++m_drawsIn;
 		auto& state = m_device.getState();
 		if (!state.isLocked())
 		{
@@ -517,12 +575,22 @@ namespace D3dDdi
 		{
 			if (m_streamSource.vertices && data.PrimitiveType >= D3DPT_TRIANGLELIST)
 			{
-				bool spriteMode = isSprite(vStart, indices[0], indices[1], indices[2]);
-				state.setSpriteMode(spriteMode);
-				if (spriteMode)
+				if (D3DPT_TRIANGLELIST == data.PrimitiveType && !flagBuffer &&
+					classifySprites(vStart, indices, data.PrimitiveCount))
 				{
-					setTextureClampMode(vStart, indices, indexCount);
+					SpriteKernels::forEachRun(m_spriteMask.data(), data.PrimitiveCount,
+						[&](UINT first, UINT end, bool spriteMode)
+						{
+							D3DDDIARG_DRAWINDEXEDPRIMITIVE2 run = data;
+							run.PrimitiveCount = end - first;
+							setSpriteMode(vStart, indices + first * 3, run.PrimitiveCount * 3, spriteMode);
+							m_device.prepareForGpuWrite();
+							state.flush();
+							batchIndexedPrimitives(run, vStart, indices + first * 3, nullptr);
+						});
+					return S_OK;
 				}
+				setSpriteMode(vStart, indices, indexCount, isSprite(vStart, indices[0], indices[1], indices[2]));
 			}
 			else
 			{
@@ -532,38 +600,25 @@ namespace D3dDdi
 			state.flush();
 		}
 
-		auto [min, max] = std::minmax_element(indices, indices + indexCount);
-		data.MinIndex = *min;
-		data.NumVertices = *max - *min + 1;
-
-		if (0 == m_batched.primitiveCount || flagBuffer ||
-			!appendPrimitives(data.PrimitiveType, vStart, data.PrimitiveCount, indices, *min, *max))
-		{
-			flushPrimitives();
-			m_batched.baseVertexIndex = vStart;
-			if (m_streamSource.vertices)
-			{
-				appendIndexedVerticesWithoutRebase(indices, indexCount, m_batched.baseVertexIndex, *min, *max);
-				m_batched.baseVertexIndex = 0;
-			}
-			else
-			{
-				m_batched.indices.assign(indices, indices + indexCount);
-				m_batched.minIndex = *min;
-				m_batched.maxIndex = *max;
-			}
-			m_batched.primitiveType = data.PrimitiveType;
-			m_batched.primitiveCount = data.PrimitiveCount;
-
-			if (flagBuffer)
-			{
-				flushPrimitives(flagBuffer);
-			}
-		}
-
+		batchIndexedPrimitives(data, vStart, indices, flagBuffer);
 		return S_OK;
 	}
 
+	void DrawPrimitive::endFrame()
+	{
+		auto& vbStats = m_vertexBuffer.getStats();
+		auto& ibStats = m_indexBuffer.getStats();
+		LOG_DEBUG << "Dynamic vertex buffer: " << m_vertexBuffer.getBufferCount() << " buffers, "
+			<< vbStats.bytesStreamed << " bytes, " << vbStats.discards << " discards, " << vbStats.busyWraps << " busy wraps";
+		LOG_DEBUG << "Dynamic index buffer: " << m_indexBuffer.getBufferCount() << " buffers, "
+			<< ibStats.bytesStreamed << " bytes, " << ibStats.discards << " discards, " << ibStats.busyWraps << " busy wraps";
+		LOG_DEBUG << "Draw calls: " << m_drawsIn << " in, " << m_drawsOut << " out";
+		m_vertexBuffer.endFrame();
+		m_indexBuffer.endFrame();
+		m_drawsIn = 0;
+		m_drawsOut = 0;
+	}
+
 	HRESULT DrawPrimitive::flush(const UINT* flagBuffer)
 	{
 		D3DDDIARG_DRAWPRIMITIVE data = {};
@@ -577,6 +632,7 @@ namespace D3dDdi
 		}
 
 		clearBatchedPrimitives();
+		++m_drawsOut;
 		return m_origVtable.pfnDrawPrimitive(m_device, &data, flagBuffer);
 	}
 
@@ -603,8 +659,11 @@ namespace D3dDdi
 			data.BaseVertexOffset = baseVertexIndex * static_cast<INT>(m_streamSource.stride);
 		}
 
+		const UINT maxIndex = m_streamSource.vertices ? data.NumVertices - 1 : m_batched.maxIndex;
+		const bool isIndex32 = maxIndex > 0xFFFF;
+
 		INT startIndex = -1;
-		if ((!m_streamSource.vertices || m_vertexBuffer) && m_indexBuffer && !flagBuffer)
+		if ((!m_streamSource.vertices || m_vertexBuffer) && m_indexBuffer && !flagBuffer && !isIndex32)
 		{
 			startIndex = loadIndices(m_batched.indices.data(), m_batched.indices.size());
 		}
@@ -621,12 +680,18 @@ namespace D3dDdi
 			dp.PrimitiveCount = data.PrimitiveCount;
 			result = m_origVtable.pfnDrawIndexedPrimitive(m_device, &dp);
 		}
+		else if (isIndex32)
+		{
+			result = m_origVtable.pfnDrawIndexedPrimitive2(m_device, &data, 4, m_batched.indices.data(), flagBuffer);
+		}
 		else
 		{
-			result = m_origVtable.pfnDrawIndexedPrimitive2(m_device, &data, 2, m_batched.indices.data(), flagBuffer);
+			m_indices16.assign(m_batched.indices.begin(), m_batched.indices.end());
+			result = m_origVtable.pfnDrawIndexedPrimitive2(m_device, &data, 2, m_indices16.data(), flagBuffer);
 		}
 
 		clearBatchedPrimitives();
+		++m_drawsOut;
 		return result;
 	}
 
@@ -647,24 +712,53 @@ namespace D3dDdi
 
 	UINT DrawPrimitive::getBatchedVertexCount() const
 	{
-		return m_batched.vertices.size() / m_streamSource.stride;
+		return m_batched.vertexCount;
+	}
+
+	bool DrawPrimitive::hasVertexStreamCapacity(UINT count) const
+	{
+		return !m_batched.streamedVertices ||
+			m_batched.vertexCount + count + MAX_STRIP_JOIN_VERTICES <= m_batched.streamCapacity;
+	}
+
+	bool DrawPrimitive::isIndexRangeSupported(D3DPRIMITIVETYPE primitiveType, INT baseVertexIndex,
+		UINT primitiveCount, UINT maxIndex) const
+	{
+		const UINT vertexCount = getVertexCount(primitiveType, primitiveCount);
+		if (m_streamSource.vertices)
+		{
+			return getBatchedVertexCount() + vertexCount + MAX_STRIP_JOIN_VERTICES - 1 <= m_maxVertexIndex;
+		}
+
+		const UINT batchedVertexCount = getVertexCount(m_batched.primitiveType, m_batched.primitiveCount);
+		if (UINT_MAX == maxIndex)
+		{
+			// Contiguous non-indexed lists are appended without generating indices
+			if (m_batched.indices.empty() &&
+				primitiveType == m_batched.primitiveType &&
+				primitiveType <= D3DPT_TRIANGLELIST &&
+				m_batched.baseVertexIndex + static_cast<INT>(batchedVertexCount) == baseVertexIndex)
+			{
+				return true;
+			}
+			maxIndex = vertexCount - 1;
+		}
+		const UINT batchedMaxIndex = m_batched.indices.empty()
+			? m_batched.baseVertexIndex + batchedVertexCount - 1
+			: m_batched.baseVertexIndex + m_batched.maxIndex;
+		return baseVertexIndex + maxIndex <= m_maxVertexIndex && batchedMaxIndex <= m_maxVertexIndex;
 	}
 
 	bool DrawPrimitive::isSprite(INT baseVertexIndex, UINT16 index0, UINT16 index1, UINT16 index2)
 	{
-		auto spriteDetection = Config::spriteDetection.get();
-		if (Config::Settings::SpriteDetection::OFF == spriteDetection ||
-			Config::Settings::SpriteDetection::POINT == spriteDetection && (
-				D3DTEXF_POINT != m_device.getState().getAppState().textureStageState[0][D3DDDITSS_MAGFILTER] ||
-				D3DTEXF_POINT != m_device.getState().getAppState().textureStageState[0][D3DDDITSS_MINFILTER]))
+		if (!isSpriteDetectionEnabled())
 		{
 			return false;
 		}
 
 		auto v = m_streamSource.vertices + baseVertexIndex * m_streamSource.stride;
 		auto v0 = reinterpret_cast<const D3DTLVERTEX*>(v + index0 * m_streamSource.stride);
-		if (Config::Settings::SpriteDetection::ZMAX == spriteDetection &&
-			v0->sz > static_cast<float>(Config::spriteDetection.getParam()) / 100)
+		if (v0->sz > getSpriteMaxZ())
 		{
 			return false;
 		}
@@ -674,9 +768,24 @@ namespace D3dDdi
 		return v0->sz == v1->sz && v0->sz == v2->sz;
 	}
 
-	INT DrawPrimitive::loadIndices(const void* indices, UINT count)
+	bool DrawPrimitive::isSpriteDetectionEnabled()
 	{
+		auto spriteDetection = Config::spriteDetection.get();
+		return Config::Settings::SpriteDetection::OFF != spriteDetection &&
+			(Config::Settings::SpriteDetection::POINT != spriteDetection || (
+				D3DTEXF_POINT == m_device.getState().getAppState().textureStageState[0][D3DDDITSS_MAGFILTER] &&
+				D3DTEXF_POINT == m_device.getState().getAppState().textureStageState[0][D3DDDITSS_MINFILTER]));
+	}
+
+	INT DrawPrimitive::loadIndices(const UINT* indices, UINT count)
+	{
+		HANDLE prevIndexBuffer = m_indexBuffer;
 		INT startIndex = m_indexBuffer.load(indices, count);
+		if (m_indexBuffer != prevIndexBuffer)
+		{
+			setIndices();
+		}
+
 		if (startIndex >= 0)
 		{
 			return startIndex;
@@ -689,6 +798,12 @@ namespace D3dDdi
 
 	INT DrawPrimitive::loadVertices(UINT count)
 	{
+		if (m_batched.streamedVertices)
+		{
+			m_batched.streamedVertices = nullptr;
+			return m_vertexBuffer.unlockStream(count * m_streamSource.stride);
+		}
+
 		auto vertices = m_batched.vertices.data();
 		if (m_vertexBuffer)
 		{
@@ -698,10 +813,7 @@ namespace D3dDdi
 				m_vertexBuffer.resize((size + VERTEX_BUFFER_SIZE - 1) / VERTEX_BUFFER_SIZE * VERTEX_BUFFER_SIZE);
 				if (m_vertexBuffer)
 				{
-					D3DDDIARG_SETSTREAMSOURCE ss = {};
-					ss.hVertexBuffer = m_vertexBuffer;
-					ss.Stride = m_streamSource.stride;
-					m_origVtable.pfnSetStreamSource(m_device, &ss);
+					setVertexBuffer();
 				}
 				else
 				{
@@ -711,7 +823,13 @@ namespace D3dDdi
 
 			if (m_vertexBuffer)
 			{
+				HANDLE prevVertexBuffer = m_vertexBuffer;
 				INT baseVertexIndex = m_vertexBuffer.load(vertices, count);
+				if (m_vertexBuffer != prevVertexBuffer)
+				{
+					setVertexBuffer();
+				}
+
 				if (baseVertexIndex >= 0)
 				{
 					return baseVertexIndex;
@@ -742,7 +860,7 @@ namespace D3dDdi
 			{
 				for (auto& index : m_batched.indices)
 				{
-					index = static_cast<UINT16>(m_batched.baseVertexIndex + index);
+					index = m_batched.baseVertexIndex + index;
 				}
 				m_batched.minIndex += m_batched.baseVertexIndex;
 				m_batched.maxIndex += m_batched.baseVertexIndex;
@@ -755,9 +873,7 @@ namespace D3dDdi
 	{
 		if (m_batched.indices.empty())
 		{
-			m_batched.vertices.reserve(m_batched.vertices.size() + m_streamSource.stride);
-			m_batched.vertices.insert(m_batched.vertices.end(),
-				m_batched.vertices.end() - m_streamSource.stride, m_batched.vertices.end());
+			writeBatchedVertices(m_batched.lastVertex.data(), 1);
 		}
 		else
 		{
@@ -770,6 +886,23 @@ namespace D3dDdi
 		m_sysMemVertexBuffers.erase(resource);
 	}
 
+	void DrawPrimitive::setIndices()
+	{
+		D3DDDIARG_SETINDICES si = {};
+		si.hIndexBuffer = m_indexBuffer;
+		si.Stride = 2;
+		m_origVtable.pfnSetIndices(m_device, &si);
+	}
+
+	void DrawPrimitive::setSpriteMode(INT baseVertexIndex, const UINT16* indices, UINT count, bool spriteMode)
+	{
+		m_device.getState().setSpriteMode(spriteMode);
+		if (spriteMode)
+		{
+			setTextureClampMode(baseVertexIndex, indices, count);
+		}
+	}
+
 	HRESULT DrawPrimitive::setStreamSource(const D3DDDIARG_SETSTREAMSOURCE& data)
 	{
 		auto it = m_sysMemVertexBuffers.find(data.hVertexBuffer);
@@ -818,6 +951,14 @@ namespace D3dDdi
 		return result;
 	}
 
+	void DrawPrimitive::setVertexBuffer()
+	{
+		D3DDDIARG_SETSTREAMSOURCE ss = {};
+		ss.hVertexBuffer = m_vertexBuffer;
+		ss.Stride = m_streamSource.stride;
+		m_origVtable.pfnSetStreamSource(m_device, &ss);
+	}
+
 	void DrawPrimitive::setTextureClampMode(INT baseVertexIndex, const UINT16* indices, UINT count)
 	{
 		if (Config::Settings::SpriteTexCoord::CLAMP != Config::spriteTexCoord.get())
@@ -849,21 +990,35 @@ namespace D3dDdi
 
 			const float texelWidth = 1 / static_cast<float>(resource->getFixedDesc().pSurfList[0].Width);
 			const float texelHeight = 1 / static_cast<float>(resource->getFixedDesc().pSurfList[0].Height);
-			const float minU = -texelWidth;
-			const float maxU = 1 + texelWidth;
-			const float minV = -texelHeight;
-			const float maxV = 1 + texelHeight;
-
-			for (UINT i = 0; i < count; ++i)
+			if (!SpriteKernels::isTexCoordInRange(vertices + decl.texCoordOffset[stage], m_streamSource.stride,
+				indices, count, -texelWidth, 1 + texelWidth, -texelHeight, 1 + texelHeight))
 			{
-				auto vertex = vertices + (indices ? indices[i] : i) * m_streamSource.stride;
-				const float* texCoord = reinterpret_cast<const float*>(vertex + decl.texCoordOffset[stage]);
-				if (texCoord[0] < minU || texCoord[0] > maxU || texCoord[1] < minV || texCoord[1] > maxV)
-				{
-					state.disableTextureClamp(stage);
-					break;
-				}
+				state.disableTextureClamp(stage);
 			}
 		}
 	}
+
+	void DrawPrimitive::writeBatchedVertices(const BYTE* vertices, UINT count)
+	{
+		if (0 == count)
+		{
+			return;
+		}
+
+		const UINT size = count * m_streamSource.stride;
+		if (m_batched.streamedVertices)
+		{
+			memcpy(m_batched.streamedVertices + m_batched.vertexCount * m_streamSource.stride, vertices, size);
+		}
+		else
+		{
+			m_batched.vertices.insert(m_batched.vertices.end(), vertices, vertices + size);
+		}
+
+		if (vertices != m_batched.lastVertex.data())
+		{
+			m_batched.lastVertex.assign(vertices + size - m_streamSource.stride, vertices + size);
+		}
+		m_batched.vertexCount += count;
+	}
 }
@@ -20,6 +20,7 @@ namespace D3dDdi
 		void addSysMemVertexBuffer(HANDLE resource, BYTE* vertices);
 		void removeSysMemVertexBuffer(HANDLE resource);
 
+		void endFrame();
 		HRESULT flushPrimitives(const UINT* flagBuffer = nullptr);
 
 		HRESULT draw(D3DDDIARG_DRAWPRIMITIVE data, const UINT* flagBuffer);
@@ -35,8 +36,12 @@ namespace D3dDdi
 			INT baseVertexIndex;
 			UINT minIndex;
 			UINT maxIndex;
+			UINT vertexCount;
+			BYTE* streamedVertices;
+			UINT streamCapacity;
 			std::vector<BYTE> vertices;
-			std::vector<UINT16> indices;
+			std::vector<BYTE> lastVertex;
+			std::vector<UINT> indices;
 		};
 
 		struct StreamSource
@@ -64,21 +69,33 @@ namespace D3dDdi
 		void appendTriangleStrip(INT baseVertexIndex, UINT primitiveCount,
 			const UINT16* indices, UINT minIndex, UINT maxIndex);
 		void appendVertices(UINT base, UINT count);
+		void batchIndexedPrimitives(const D3DDDIARG_DRAWINDEXEDPRIMITIVE2& data, INT vStart,
+			const UINT16* indices, const UINT* flagBuffer);
+		void batchPrimitives(const D3DDDIARG_DRAWPRIMITIVE& data, const UINT* flagBuffer);
+		void beginVertexStream(UINT count);
+		bool classifySprites(INT baseVertexIndex, const UINT16* indices, UINT primitiveCount);
 		void clearBatchedPrimitives();
 		void convertIndexedTriangleFanToList(UINT startPrimitive, UINT primitiveCount);
 		void convertIndexedTriangleStripToList(UINT startPrimitive, UINT primitiveCount);
 		void convertToTriangleList();
 		HRESULT flush(const UINT* flagBuffer);
 		HRESULT flushIndexed(const UINT* flagBuffer);
+		bool hasVertexStreamCapacity(UINT count) const;
+		bool isIndexRangeSupported(D3DPRIMITIVETYPE primitiveType, INT baseVertexIndex,
+			UINT primitiveCount, UINT maxIndex) const;
 		bool isSprite(INT baseVertexIndex, UINT16 index0, UINT16 index1, UINT16 index2);
-		INT loadIndices(const void* indices, UINT count);
+		bool isSpriteDetectionEnabled();
+		INT loadIndices(const UINT* indices, UINT count);
 		INT loadVertices(UINT count);
 		UINT getBatchedVertexCount() const;
 		void rebaseIndices();
 		void repeatLastBatchedVertex();
-
+		void setIndices();
+		void setSpriteMode(INT baseVertexIndex, const UINT16* indices, UINT count, bool spriteMode);
 		HRESULT setSysMemStreamSource(const BYTE* vertices, UINT stride);
 		void setTextureClampMode(INT baseVertexIndex, const UINT16* indices, UINT count);
+		void setVertexBuffer();
+		void writeBatchedVertices(const BYTE* vertices, UINT count);
 
 		Device& m_device;
 		const D3DDDI_DEVICEFUNCS& m_origVtable;
@@ -87,5 +104,11 @@ namespace D3dDdi
 		StreamSource m_streamSource;
 		std::map<HANDLE, BYTE*> m_sysMemVertexBuffers;
 		BatchedPrimitives m_batched;
+		std::vector<UINT> m_convertedIndices;
+		std::vector<UINT16> m_indices16;
+		std::vector<UINT> m_spriteMask;
+		UINT m_maxVertexIndex;
+		UINT m_drawsIn;
+		UINT m_drawsOut;
 	};
 }
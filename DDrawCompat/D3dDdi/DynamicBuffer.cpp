@@ -1,8 +1,13 @@
+#include <algorithm>
+
 #include <D3dDdi/Device.h>
 #include <D3dDdi/DynamicBuffer.h>
 
 namespace
 {
+	const UINT MAX_BUFFER_COUNT = 4;
+	const UINT MIN_RING_BUFFER_COUNT = 2;
+
 	D3DDDI_RESOURCEFLAGS getIndexBufferFlag()
 	{
 		D3DDDI_RESOURCEFLAGS flags = {};
@@ -22,40 +27,93 @@ namespace D3dDdi
 {
 	DynamicBuffer::DynamicBuffer(Device& device, UINT size, D3DDDIFORMAT format, D3DDDI_RESOURCEFLAGS resourceFlag)
 		: m_device(device)
-		, m_resource(nullptr, [&](HANDLE vb) { device.getOrigVtable().pfnDestroyResource(device, vb); })
 		, m_size(size)
 		, m_format(format)
 		, m_resourceFlag(resourceFlag)
 		, m_stride(0)
 		, m_pos(0)
+		, m_current(0)
+		, m_isDiscardNeeded(true)
+		, m_stats{}
 	{
 		resize(size);
 	}
 
-	void* DynamicBuffer::lock(UINT size)
+	bool DynamicBuffer::addBuffer(UINT size)
 	{
-		D3DDDIARG_LOCK lock = {};
-		lock.hResource = m_resource.get();
-		lock.Range.Offset = m_pos;
-		lock.Range.Size = size;
-		lock.Flags.RangeValid = 1;
+		D3DDDI_SURFACEINFO surfaceInfo = {};
+		surfaceInfo.Width = size;
+		surfaceInfo.Height = 1;
 
-		if (0 == m_pos)
+		D3DDDIARG_CREATERESOURCE2 cr = {};
+		cr.Format = m_format;
+		cr.Pool = D3DDDIPOOL_VIDEOMEMORY;
+		cr.pSurfList = &surfaceInfo;
+		cr.SurfCount = 1;
+		cr.Flags = m_resourceFlag;
+		cr.Flags.Dynamic = 1;
+		cr.Flags.WriteOnly = 1;
+		cr.Rotation = D3DDDI_ROTATION_IDENTITY;
+
+		if (FAILED(m_device.createPrivateResource(cr)))
 		{
-			lock.Flags.Discard = 1;
+			return false;
 		}
-		else
+
+		auto& device = m_device;
+		Buffer buffer = {};
+		buffer.resource = { cr.hResource, [&device](HANDLE vb) { device.getOrigVtable().pfnDestroyResource(device, vb); } };
+
+		D3DDDIARG_CREATEQUERY createQuery = {};
+		createQuery.QueryType = D3DDDIQUERYTYPE_EVENT;
+		if (SUCCEEDED(m_device.getOrigVtable().pfnCreateQuery(m_device, &createQuery)))
 		{
-			lock.Flags.WriteOnly = 1;
-			lock.Flags.NoOverwrite = 1;
+			buffer.eventQuery = { createQuery.hQuery,
+				[&device](HANDLE query) { device.getOrigVtable().pfnDestroyQuery(device, query); } };
 		}
 
-		HRESULT result = m_device.getOrigVtable().pfnLock(m_device, &lock);
-		if (FAILED(result))
+		m_buffers.push_back(std::move(buffer));
+		return true;
+	}
+
+	void DynamicBuffer::endFrame()
+	{
+		if (0 != m_size)
 		{
-			return nullptr;
+			const UINT requiredCount = std::min<UINT>(MAX_BUFFER_COUNT, std::max<UINT>(
+				MIN_RING_BUFFER_COUNT + static_cast<UINT>(m_stats.bytesStreamed / m_size),
+				m_buffers.size() + (0 != m_stats.busyWraps ? 1 : 0)));
+
+			while (m_buffers.size() < requiredCount && m_buffers.back().eventQuery && addBuffer(m_size))
+			{
+			}
+
+			if (m_buffers.size() > 1 && !m_buffers.back().eventQuery)
+			{
+				m_buffers.pop_back();
+			}
 		}
-		return lock.pSurfData;
+
+		m_stats = {};
+	}
+
+	bool DynamicBuffer::isIdle(Buffer& buffer)
+	{
+		if (!buffer.isQueryIssued)
+		{
+			return true;
+		}
+
+		BOOL result = FALSE;
+		D3DDDIARG_GETQUERYDATA getQueryData = {};
+		getQueryData.hQuery = buffer.eventQuery.get();
+		getQueryData.pData = &result;
+		if (S_OK == m_device.getOrigVtable().pfnGetQueryData(m_device, &getQueryData))
+		{
+			buffer.isQueryIssued = false;
+			return true;
+		}
+		return false;
 	}
 
 	INT DynamicBuffer::load(const void* src, UINT count)
@@ -63,7 +121,7 @@ namespace D3dDdi
 		UINT size = count * m_stride;
 		if (m_pos + size > m_size)
 		{
-			m_pos = 0;
+			wrap();
 		}
 
 		UINT pos = m_pos;
@@ -76,36 +134,56 @@ namespace D3dDdi
 		memcpy(dst, src, size);
 		unlock();
 		m_pos += size;
+		m_stats.bytesStreamed += size;
 		return pos / m_stride;
 	}
 
-	void DynamicBuffer::resize(UINT size)
+	void* DynamicBuffer::lock(UINT size)
 	{
-		m_size = 0;
-		if (0 == size)
+		D3DDDIARG_LOCK lock = {};
+		lock.hResource = *this;
+		lock.Range.Offset = m_pos;
+		lock.Range.Size = size;
+		lock.Flags.RangeValid = 1;
+
+		if (0 == m_pos && m_isDiscardNeeded)
 		{
-			m_resource.reset();
-			return;
+			lock.Flags.Discard = 1;
+			m_isDiscardNeeded = false;
+			++m_stats.discards;
+		}
+		else
+		{
+			lock.Flags.WriteOnly = 1;
+			lock.Flags.NoOverwrite = 1;
 		}
 
-		D3DDDI_SURFACEINFO surfaceInfo = {};
-		surfaceInfo.Width = size;
-		surfaceInfo.Height = 1;
+		HRESULT result = m_device.getOrigVtable().pfnLock(m_device, &lock);
+		if (FAILED(result))
+		{
+			return nullptr;
+		}
+		return lock.pSurfData;
+	}
 
-		D3DDDIARG_CREATERESOURCE2 cr = {};
-		cr.Format = m_format;
-		cr.Pool = D3DDDIPOOL_VIDEOMEMORY;
-		cr.pSurfList = &surfaceInfo;
-		cr.SurfCount = 1;
-		cr.Flags = m_resourceFlag;
-		cr.Flags.Dynamic = 1;
-		cr.Flags.WriteOnly = 1;
-		cr.Rotation = D3DDDI_ROTATION_IDENTITY;
+	void* DynamicBuffer::lockStream(UINT minSize)
+	{
+		if (m_pos + minSize > m_size)
+		{
+			wrap();
+		}
+		return lock(m_size - m_pos);
+	}
 
-		m_resource.reset();
-		if (SUCCEEDED(m_device.createPrivateResource(cr)))
+	void DynamicBuffer::resize(UINT size)
+	{
+		m_size = 0;
+		m_pos = 0;
+		m_current = 0;
+		m_isDiscardNeeded = true;
+		m_buffers.clear();
+		if (0 != size && addBuffer(size))
 		{
-			m_resource.reset(cr.hResource);
 			m_size = size;
 		}
 	}
@@ -119,16 +197,63 @@ namespace D3dDdi
 	void DynamicBuffer::unlock()
 	{
 		D3DDDIARG_UNLOCK unlock = {};
-		unlock.hResource = m_resource.get();
+		unlock.hResource = *this;
 		m_device.getOrigVtable().pfnUnlock(m_device, &unlock);
 	}
 
+	INT DynamicBuffer::unlockStream(UINT size)
+	{
+		unlock();
+		UINT pos = m_pos;
+		m_pos += size;
+		m_stats.bytesStreamed += size;
+		return pos / m_stride;
+	}
+
+	void DynamicBuffer::wrap()
+	{
+		m_pos = 0;
+		if (m_buffers.size() > 1)
+		{
+			auto& prevBuffer = m_buffers[m_current];
+			D3DDDIARG_ISSUEQUERY issueQuery = {};
+			issueQuery.hQuery = prevBuffer.eventQuery.get();
+			issueQuery.Flags.End = 1;
+			prevBuffer.isQueryIssued = SUCCEEDED(m_device.getOrigVtable().pfnIssueQuery(m_device, &issueQuery));
+
+			m_current = (m_current + 1) % m_buffers.size();
+			if (isIdle(m_buffers[m_current]))
+			{
+				m_isDiscardNeeded = false;
+				return;
+			}
+			++m_stats.busyWraps;
+		}
+		m_isDiscardNeeded = true;
+	}
+
 	DynamicIndexBuffer::DynamicIndexBuffer(Device& device, UINT size)
 		: DynamicBuffer(device, size, D3DDDIFMT_INDEX16, getIndexBufferFlag())
 	{
 		m_stride = 2;
 	}
 
+	INT DynamicIndexBuffer::load(const UINT* indices, UINT count)
+	{
+		const UINT size = count * m_stride;
+		auto dst = static_cast<UINT16*>(lockStream(size));
+		if (!dst)
+		{
+			return -1;
+		}
+
+		for (UINT i = 0; i < count; ++i)
+		{
+			dst[i] = static_cast<UINT16>(indices[i]);
+		}
+		return unlockStream(size);
+	}
+
 	DynamicVertexBuffer::DynamicVertexBuffer(Device& device, UINT size)
 		: DynamicBuffer(device, size, D3DDDIFMT_VERTEXDATA, getVertexBufferFlag())
 	{
@@ -2,6 +2,7 @@
 
 #include <functional>
 #include <memory>
+#include <vector>
 
 #include <d3d.h>
 #include <d3dumddi.h>
@@ -13,11 +14,24 @@ namespace D3dDdi
 	class DynamicBuffer
 	{
 	public:
+		struct Stats
+		{
+			UINT discards;
+			UINT busyWraps;
+			UINT64 bytesStreamed;
+		};
+
+		void endFrame();
+		UINT getBufferCount() const { return m_buffers.size(); }
 		UINT getSize() const { return m_size; }
+		const Stats& getStats() const { return m_stats; }
+		UINT getStreamCapacity() const { return m_size - m_pos; }
 		INT load(const void* src, UINT count);
+		void* lockStream(UINT minSize);
 		void resize(UINT size);
+		INT unlockStream(UINT size);
 
-		operator HANDLE() const { return m_resource.get(); }
+		operator HANDLE() const { return m_buffers.empty() ? nullptr : m_buffers[m_current].resource.get(); }
 
 	protected:
 		DynamicBuffer(Device& device, UINT size, D3DDDIFORMAT format, D3DDDI_RESOURCEFLAGS resourceFlag);
@@ -27,18 +41,37 @@ namespace D3dDdi
 		void unlock();
 
 		Device& m_device;
-		std::unique_ptr<void, std::function<void(HANDLE)>> m_resource;
 		UINT m_size;
 		D3DDDIFORMAT m_format;
 		D3DDDI_RESOURCEFLAGS m_resourceFlag;
 		UINT m_stride;
 		UINT m_pos;
+
+	private:
+		struct Buffer
+		{
+			std::unique_ptr<void, std::function<void(HANDLE)>> resource;
+			std::unique_ptr<void, std::function<void(HANDLE)>> eventQuery;
+			bool isQueryIssued;
+		};
+
+		bool addBuffer(UINT size);
+		bool isIdle(Buffer& buffer);
+		void wrap();
+
+		std::vector<Buffer> m_buffers;
+		UINT m_current;
+		bool m_isDiscardNeeded;
+		Stats m_stats;
 	};
 
 	class DynamicIndexBuffer : public DynamicBuffer
 	{
 	public:
 		DynamicIndexBuffer(Device& device, UINT size);
+
+		using DynamicBuffer::load;
+		INT load(const UINT* indices, UINT count);
 	};
 
 	class DynamicVertexBuffer : public DynamicBuffer
@@ -0,0 +1,126 @@
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+#include <D3dDdi/IndexKernels.h>
+
+namespace
+{
+	__m128i select(__m128i mask, __m128i a, __m128i b)
+	{
+		return _mm_or_si128(_mm_and_si128(mask, a), _mm_andnot_si128(mask, b));
+	}
+}
+
+namespace D3dDdi
+{
+	namespace IndexKernels
+	{
+		void convertTriangleFanToList(UINT* dst, const UINT* src, UINT primitiveCount)
+		{
+			const __m128i start = _mm_set1_epi32(src[0]);
+			const __m128i mask0 = _mm_setr_epi32(-1, -1, 0, -1);
+			const __m128i mask1 = _mm_setr_epi32(-1, 0, -1, -1);
+			const __m128i mask2 = _mm_setr_epi32(0, -1, -1, 0);
+
+			UINT i = 0;
+			for (; i + 4 <= primitiveCount; i += 4)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 1));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 2));
+				auto out = reinterpret_cast<__m128i*>(dst + i * 3);
+				_mm_storeu_si128(out, select(mask0, _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 1, 1, 0)), start));
+				_mm_storeu_si128(out + 1, select(mask1, _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 2, 2, 2)), start));
+				_mm_storeu_si128(out + 2, select(mask2, _mm_shuffle_epi32(b, _MM_SHUFFLE(0, 3, 2, 0)), start));
+			}
+
+			for (; i < primitiveCount; ++i)
+			{
+				dst[i * 3] = src[i + 1];
+				dst[i * 3 + 1] = src[i + 2];
+				dst[i * 3 + 2] = src[0];
+			}
+		}
+
+		void convertTriangleStripToList(UINT* dst, const UINT* src, UINT primitiveCount)
+		{
+			UINT i = 0;
+			for (; i + 4 <= primitiveCount; i += 4)
+			{
+				const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i));
+				const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + i + 2));
+				auto out = reinterpret_cast<__m128i*>(dst + i * 3);
+				_mm_storeu_si128(out, _mm_shuffle_epi32(a, _MM_SHUFFLE(1, 2, 1, 0)));
+				_mm_storeu_si128(out + 1, _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 2, 2, 3)));
+				_mm_storeu_si128(out + 2, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 3, 1, 2)));
+			}
+
+			for (; i < primitiveCount; ++i)
+			{
+				const UINT odd = i % 2;
+				dst[i * 3] = src[i];
+				dst[i * 3 + 1] = src[i + 1 + odd];
+				dst[i * 3 + 2] = src[i + 2 - odd];
+			}
+		}
+
+		void generateTriangleFanList(UINT* dst, UINT base, UINT primitiveCount)
+		{
+			const __m128i start = _mm_set1_epi32(base);
+			const __m128i mask0 = _mm_setr_epi32(-1, -1, 0, -1);
+			const __m128i mask1 = _mm_setr_epi32(-1, 0, -1, -1);
+			const __m128i mask2 = _mm_setr_epi32(0, -1, -1, 0);
+			const __m128i offset0 = _mm_setr_epi32(1, 2, 0, 2);
+			const __m128i offset1 = _mm_setr_epi32(3, 0, 3, 4);
+			const __m128i offset2 = _mm_setr_epi32(0, 4, 5, 0);
+			const __m128i step = _mm_set1_epi32(4);
+
+			UINT i = 0;
+			__m128i index = start;
+			for (; i + 4 <= primitiveCount; i += 4)
+			{
+				auto out = reinterpret_cast<__m128i*>(dst + i * 3);
+				_mm_storeu_si128(out, select(mask0, _mm_add_epi32(index, offset0), start));
+				_mm_storeu_si128(out + 1, select(mask1, _mm_add_epi32(index, offset1), start));
+				_mm_storeu_si128(out + 2, select(mask2, _mm_add_epi32(index, offset2), start));
+				index = _mm_add_epi32(index, step);
+			}
+
+			for (; i < primitiveCount; ++i)
+			{
+				dst[i * 3] = base + i + 1;
+				dst[i * 3 + 1] = base + i + 2;
+				dst[i * 3 + 2] = base;
+			}
+		}
+
+		void generateTriangleStripList(UINT* dst, UINT base, UINT primitiveCount)
+		{
+			const __m128i offset0 = _mm_setr_epi32(0, 1, 2, 1);
+			const __m128i offset1 = _mm_setr_epi32(3, 2, 2, 3);
+			const __m128i offset2 = _mm_setr_epi32(4, 3, 5, 4);
+			const __m128i step = _mm_set1_epi32(4);
+
+			UINT i = 0;
+			__m128i index = _mm_set1_epi32(base);
+			for (; i + 4 <= primitiveCount; i += 4)
+			{
+				auto out = reinterpret_cast<__m128i*>(dst + i * 3);
+				_mm_storeu_si128(out, _mm_add_epi32(index, offset0));
+				_mm_storeu_si128(out + 1, _mm_add_epi32(index, offset1));
+				_mm_storeu_si128(out + 2, _mm_add_epi32(index, offset2));
+				index = _mm_add_epi32(index, step);
+			}
+
+			for (; i < primitiveCount; ++i)
+			{
+				const UINT odd = i % 2;
+				dst[i * 3] = base + i;
+				dst[i * 3 + 1] = base + i + 1 + odd;
+				dst[i * 3 + 2] = base + i + 2 - odd;
+			}
+		}
+	}
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Common/Portability.h>
+
+namespace D3dDdi
+{
+	namespace IndexKernels
+	{
+		// Each function writes primitiveCount * 3 triangle list indices to dst
+		void convertTriangleFanToList(UINT* dst, const UINT* src, UINT primitiveCount);
+		void convertTriangleStripToList(UINT* dst, const UINT* src, UINT primitiveCount);
+		void generateTriangleFanList(UINT* dst, UINT base, UINT primitiveCount);
+		void generateTriangleStripList(UINT* dst, UINT base, UINT primitiveCount);
+	}
+}
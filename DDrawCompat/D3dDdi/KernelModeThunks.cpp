@@ -7,6 +7,7 @@
 #include <Common/Hook.h>
 #include <Common/ScopedSrwLock.h>
 #include <Common/Time.h>
+#include <Common/VsyncEstimator.h>
 #include <Config/Config.h>
 #include <D3dDdi/Device.h>
 #include <D3dDdi/KernelModeThunks.h>
@@ -34,6 +35,7 @@ namespace
 
 	long long g_qpcLastVsync = 0;
 	UINT g_vsyncCounter = 0;
+	VsyncEstimator g_vsyncEstimator;
 	CONDITION_VARIABLE g_vsyncCounterCv = CONDITION_VARIABLE_INIT;
 	Compat::SrwLock g_vsyncCounterSrwLock;
 
@@ -333,6 +335,7 @@ namespace
 			{
 				Compat::ScopedSrwLockExclusive lock(g_vsyncCounterSrwLock);
 				g_qpcLastVsync = Time::queryPerformanceCounter();
+				g_vsyncEstimator.addVsync(g_qpcLastVsync);
 				++g_vsyncCounter;
 			}
 
@@ -408,6 +411,12 @@ namespace D3dDdi
 			return g_qpcLastVsync;
 		}
 
+		long long getQpcNextVsync(long long qpc)
+		{
+			Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
+			return g_vsyncEstimator.getNextVsync(qpc);
+		}
+
 		UINT getVsyncCounter()
 		{
 			Compat::ScopedSrwLockShared lock(g_vsyncCounterSrwLock);
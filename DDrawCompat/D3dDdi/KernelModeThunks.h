@@ -26,6 +26,7 @@ namespace D3dDdi
 		AdapterInfo getAdapterInfo(CompatRef<IDirectDraw7> dd);
 		AdapterInfo getLastOpenAdapterInfo();
 		long long getQpcLastVsync();
+		long long getQpcNextVsync(long long qpc);
 		UINT getVsyncCounter();
 		void installHooks();
 		void setDcFormatOverride(UINT format);
@@ -0,0 +1,129 @@
+#include <array>
+#include <atomic>
+#include <sstream>
+
+#include <Config/Config.h>
+#include <D3dDdi/MemoryUsage.h>
+
+namespace
+{
+	const UINT64 MB = 1024 * 1024;
+
+	const std::array<const char*, D3dDdi::MemoryUsage::CATEGORY_COUNT> g_categoryNames = {
+		"lock", "ref", "msaa", "resolved", "null", "repo"
+	};
+
+	std::array<std::atomic<UINT64>, D3dDdi::MemoryUsage::CATEGORY_COUNT> g_usage = {};
+	std::atomic<UINT64> g_total(0);
+
+	struct UsageSummary
+	{
+		UINT64 divisor;
+		const char* unit;
+	};
+
+	std::ostream& operator<<(std::ostream& os, const UsageSummary& summary)
+	{
+		os << "Memory " << g_total / summary.divisor;
+		const UINT64 budget = D3dDdi::MemoryUsage::getBudget();
+		if (0 != budget)
+		{
+			os << '/' << budget / summary.divisor;
+		}
+		os << ' ' << summary.unit << ':';
+		const char* separator = " ";
+		for (UINT i = 0; i < g_usage.size(); ++i)
+		{
+			if (D3dDdi::MemoryUsage::LOCK_BUFFER != i)
+			{
+				os << separator << g_categoryNames[i] << ' ' << g_usage[i] / summary.divisor;
+				separator = ", ";
+			}
+		}
+		os << "; system memory " << g_categoryNames[D3dDdi::MemoryUsage::LOCK_BUFFER] << ' '
+			<< g_usage[D3dDdi::MemoryUsage::LOCK_BUFFER] / summary.divisor;
+		return os;
+	}
+}
+
+namespace D3dDdi
+{
+	namespace MemoryUsage
+	{
+		Allocation::Allocation(Category category, UINT64 size)
+			: m_category(category)
+			, m_baseSize(size)
+			, m_size(size)
+		{
+			add(m_category, m_size);
+		}
+
+		Allocation::~Allocation()
+		{
+			remove(m_category, m_size);
+		}
+
+		void Allocation::setCategory(Category category, UINT sampleCount)
+		{
+			remove(m_category, m_size);
+			m_category = category;
+			m_size = m_baseSize * sampleCount;
+			add(m_category, m_size);
+		}
+
+		void add(Category category, UINT64 size)
+		{
+			if (0 == size)
+			{
+				return;
+			}
+
+			g_usage[category] += size;
+			if (LOCK_BUFFER != category)
+			{
+				g_total += size;
+			}
+		}
+
+		UINT64 getBudget()
+		{
+			if (Config::Settings::MemoryBudget::ON != Config::memoryBudget.get())
+			{
+				return 0;
+			}
+			return Config::memoryBudget.getParam() * MB;
+		}
+
+		std::string getSummary()
+		{
+			std::ostringstream oss;
+			oss << UsageSummary{ MB, "MB" };
+			return oss.str();
+		}
+
+		UINT64 getTotal()
+		{
+			return g_total;
+		}
+
+		bool isWithinBudget(UINT64 size)
+		{
+			const UINT64 budget = getBudget();
+			return 0 == budget || getTotal() + size <= budget;
+		}
+
+		void remove(Category category, UINT64 size)
+		{
+			if (0 == size)
+			{
+				return;
+			}
+
+			g_usage[category] -= size;
+			if (LOCK_BUFFER != category)
+			{
+				g_total -= size;
+			}
+		}
+	}
+}
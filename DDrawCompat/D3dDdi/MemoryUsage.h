@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string>
+
+#include <Windows.h>
+
+namespace D3dDdi
+{
+	namespace MemoryUsage
+	{
+		enum Category
+		{
+			// System memory, reported separately and not counted against the budget
+			LOCK_BUFFER,
+			LOCK_REF,
+			MSAA,
+			MSAA_RESOLVED,
+			NULL_SURFACE,
+			REPOSITORY,
+			CATEGORY_COUNT
+		};
+
+		class Allocation
+		{
+		public:
+			Allocation(Category category, UINT64 size);
+			~Allocation();
+
+			Allocation(const Allocation&) = delete;
+			Allocation(Allocation&&) = delete;
+			Allocation& operator=(const Allocation&) = delete;
+			Allocation& operator=(Allocation&&) = delete;
+
+			UINT64 getSize() const { return m_size; }
+			void setCategory(Category category, UINT sampleCount = 1);
+
+		private:
+			Category m_category;
+			UINT64 m_baseSize;
+			UINT64 m_size;
+		};
+
+		void add(Category category, UINT64 size);
+		UINT64 getBudget();
+		std::string getSummary();
+		UINT64 getTotal();
+		bool isWithinBudget(UINT64 size);
+		void remove(Category category, UINT64 size);
+	}
+}
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <type_traits>
 
 #include <Common/Comparison.h>
@@ -10,6 +11,7 @@
 #include <D3dDdi/Device.h>
 #include <D3dDdi/KernelModeThunks.h>
 #include <D3dDdi/Log/DeviceFuncsLog.h>
+#include <D3dDdi/MemoryUsage.h>
 #include <D3dDdi/Resource.h>
 #include <D3dDdi/ScopedCriticalSection.h>
 #include <D3dDdi/SurfaceRepository.h>
@@ -26,6 +28,24 @@
 
 namespace
 {
+	const std::size_t MAX_DIRTY_RECTS = 16;
+	const std::size_t MAX_DOWNSCALE_CHAINS = 4;
+	const long long READBACK_PREDICTION_MS = 1000;
+
+	struct CopyStats
+	{
+		UINT64 sysMemBytes;
+		UINT64 sysMemFullBytes;
+		UINT64 vidMemBytes;
+		UINT64 vidMemFullBytes;
+		UINT readbackHits;
+		UINT readbackMisses;
+		UINT readbackWaste;
+		UINT forcedRefreshes;
+	};
+
+	CopyStats g_copyStats = {};
+
 	D3DDDI_RESOURCEFLAGS getResourceTypeFlags();
 
 	const UINT g_resourceTypeFlags = getResourceTypeFlags().Value;
@@ -90,8 +110,14 @@ namespace
 		return flags;
 	}
 
+	UINT getSampleCount(const std::pair<D3DDDIMULTISAMPLE_TYPE, UINT>& msaa)
+	{
+		return std::max<UINT>(msaa.first, 2);
+	}
+
 	void heapFree(void* p)
 	{
+		D3dDdi::MemoryUsage::remove(D3dDdi::MemoryUsage::LOCK_BUFFER, HeapSize(GetProcessHeap(), 0, p));
 		HeapFree(GetProcessHeap(), 0, p);
 	}
 
@@ -100,6 +126,15 @@ namespace
 		LOG_ONCE("Warning: Resolving multisampled depth buffers is not supported by the GPU. "
 			"Disable antialiasing if experiencing visual glitches.");
 	}
+
+	void setMemoryUsageCategory(D3dDdi::SurfaceRepository::Surface& surface,
+		D3dDdi::MemoryUsage::Category category, UINT sampleCount = 1)
+	{
+		if (surface.allocation)
+		{
+			surface.allocation->setCategory(category, sampleCount);
+		}
+	}
 }
 
 namespace D3dDdi
@@ -128,6 +163,7 @@ namespace D3dDdi
 		, m_palettizedTexture(nullptr)
 		, m_paletteHandle(0)
 		, m_paletteColorKeyIndex(-1)
+		, m_palettizedTextureDirtyRect{}
 		, m_isOversized(false)
 		, m_isSurfaceRepoResource(SurfaceRepository::inCreateSurface())
 		, m_isClampable(true)
@@ -184,6 +220,7 @@ namespace D3dDdi
 		else
 		{
 			createLockResource();
+			resetDirtyRects();
 		}
 
 		data.hResource = m_fixedData.hResource;
@@ -205,6 +242,74 @@ namespace D3dDdi
 		}
 	}
 
+	void Resource::addDirtyRect(UINT subResourceIndex, const RECT& rect)
+	{
+		if (subResourceIndex < m_dirtyRects.size())
+		{
+			addDirtyRect(m_dirtyRects[subResourceIndex], subResourceIndex, rect);
+		}
+	}
+
+	void Resource::addDirtyRect(std::vector<RECT>& dirtyRects, UINT subResourceIndex, const RECT& rect)
+	{
+		const RECT surfaceRect = getRect(subResourceIndex);
+		RECT r = {};
+		IntersectRect(&r, &rect, &surfaceRect);
+		Rect::unite(dirtyRects, r, MAX_DIRTY_RECTS);
+	}
+
+	void Resource::addVidMemDirtyRect(UINT subResourceIndex, const RECT& rect)
+	{
+		if (subResourceIndex < m_vidMemDirtyRects.size())
+		{
+			if (m_lockData[subResourceIndex].isSysMemUpToDate)
+			{
+				m_vidMemDirtyRects[subResourceIndex].clear();
+			}
+			addDirtyRect(m_vidMemDirtyRects[subResourceIndex], subResourceIndex, rect);
+		}
+		m_lockData[subResourceIndex].isSysMemUpToDate = false;
+		cancelReadback(subResourceIndex);
+	}
+
+	void Resource::applyMemoryBudget(std::pair<D3DDDIMULTISAMPLE_TYPE, UINT>& msaa, D3DDDIFORMAT formatConfig,
+		SIZE& scaledSize)
+	{
+		const UINT64 budget = MemoryUsage::getBudget();
+		if (0 == budget)
+		{
+			return;
+		}
+
+		UINT64 currentSize = 0;
+		for (auto surface : { &m_msaaSurface, &m_msaaResolvedSurface, &m_nullSurface, &m_lockRefSurface })
+		{
+			if (surface->allocation)
+			{
+				currentSize += surface->allocation->getSize();
+			}
+		}
+
+		auto isWithinBudget = [&]()
+			{
+				return MemoryUsage::getTotal() - currentSize + getConfigMemoryUsage(msaa, formatConfig, scaledSize) <= budget;
+			};
+
+		if (D3DDDIMULTISAMPLE_NONE != msaa.first && !isWithinBudget())
+		{
+			LOG_ONCE("Warning: MemoryBudget exceeded, disabling antialiasing");
+			msaa = { D3DDDIMULTISAMPLE_NONE, 0 };
+		}
+
+		const SIZE size = { static_cast<LONG>(m_fixedData.pSurfList[0].Width),
+			static_cast<LONG>(m_fixedData.pSurfList[0].Height) };
+		if (scaledSize != size && !isWithinBudget())
+		{
+			LOG_ONCE("Warning: MemoryBudget exceeded, disabling resolution scaling");
+			scaledSize = size;
+		}
+	}
+
 	HRESULT Resource::blt(D3DDDIARG_BLT data)
 	{
 		if (m_fixedData.Flags.ZBuffer && m_msaaSurface.resource &&
@@ -267,8 +372,15 @@ namespace D3dDdi
 			}
 			else
 			{
+				if (!data.Flags.WriteOnly && !data.Flags.Discard)
+				{
+					predictReadback(data.SubResourceIndex);
+				}
 				prepareForCpuWrite(data.SubResourceIndex);
+				addDirtyRect(data.SubResourceIndex,
+					data.Flags.AreaValid ? data.Area : getRect(data.SubResourceIndex));
 			}
+			++m_lockData[data.SubResourceIndex].lockCount;
 		}
 
 		auto& lockData = m_lockData[data.SubResourceIndex];
@@ -448,6 +560,15 @@ namespace D3dDdi
 		return result;
 	}
 
+	void Resource::cancelReadback(UINT subResourceIndex)
+	{
+		if (m_lockData[subResourceIndex].isReadbackPending)
+		{
+			++g_copyStats.readbackWaste;
+			m_lockData[subResourceIndex].isReadbackPending = false;
+		}
+	}
+
 	void Resource::clearRectExterior(UINT subResourceIndex, const RECT& rect)
 	{
 		const LONG width = m_fixedData.pSurfList[subResourceIndex].Width;
@@ -485,6 +606,11 @@ namespace D3dDdi
 		m_lockData[subResourceIndex].isMsaaResolvedUpToDate = false;
 		m_lockData[subResourceIndex].isVidMemUpToDate = false;
 		m_lockData[subResourceIndex].isSysMemUpToDate = false;
+		cancelReadback(subResourceIndex);
+		if (subResourceIndex < m_vidMemDirtyRects.size())
+		{
+			m_vidMemDirtyRects[subResourceIndex].assign(1, getRect(subResourceIndex));
+		}
 	}
 
 	void Resource::clipRect(UINT subResourceIndex, RECT& rect)
@@ -515,6 +641,7 @@ namespace D3dDdi
 				DDraw::Blitter::colorFill(dstBuf, lockData.pitch,
 					data.DstRect.right - data.DstRect.left, data.DstRect.bottom - data.DstRect.top,
 					m_formatInfo.bytesPerPixel, convertFrom32Bit(m_formatInfo, data.Color));
+				addDirtyRect(data.SubResourceIndex, data.DstRect);
 
 				return LOG_RESULT(S_OK);
 			}
@@ -562,6 +689,26 @@ namespace D3dDdi
 		return result;
 	}
 
+	void Resource::copyToSysMemResource(UINT subResourceIndex)
+	{
+		loadVidMemResource(subResourceIndex);
+		const RECT surfaceRect = getRect(subResourceIndex);
+		g_copyStats.sysMemFullBytes += getRectSize(surfaceRect);
+		if (subResourceIndex < m_vidMemDirtyRects.size())
+		{
+			for (const auto& rect : m_vidMemDirtyRects[subResourceIndex])
+			{
+				copySubResourceRegion(m_lockResource.get(), subResourceIndex, rect, m_handle, subResourceIndex, rect);
+				g_copyStats.sysMemBytes += getRectSize(rect);
+			}
+		}
+		else
+		{
+			copySubResource(m_lockResource.get(), *this, subResourceIndex);
+			g_copyStats.sysMemBytes += getRectSize(surfaceRect);
+		}
+	}
+
 	void Resource::createGdiLockResource()
 	{
 		LOG_FUNC("Resource::createGdiLockResource");
@@ -621,6 +768,10 @@ namespace D3dDdi
 		std::uintptr_t bufferSize = reinterpret_cast<std::uintptr_t>(surfaceInfo.back().pSysMem) +
 			surfaceInfo.back().SysMemPitch * surfaceInfo.back().Height + ALIGNMENT;
 		m_lockBuffer.reset(HeapAlloc(GetProcessHeap(), HEAP_ZERO_MEMORY, bufferSize));
+		if (m_lockBuffer)
+		{
+			MemoryUsage::add(MemoryUsage::LOCK_BUFFER, bufferSize);
+		}
 
 		BYTE* bufferStart = static_cast<BYTE*>(DDraw::Surface::alignBuffer(m_lockBuffer.get()));
 		for (UINT i = 0; i < m_fixedData.SurfCount; ++i)
@@ -660,6 +811,7 @@ namespace D3dDdi
 				m_lockData[i].isMsaaUpToDate = m_msaaSurface.resource;
 				m_lockData[i].isMsaaResolvedUpToDate = m_msaaResolvedSurface.resource;
 				m_lockData[i].isRefLocked = false;
+				m_lockData[i].isReadbackPending = false;
 			}
 		}
 
@@ -671,27 +823,90 @@ namespace D3dDdi
 		m_isClampable = false;
 	}
 
-	void Resource::downscale(Resource*& rt, LONG& srcWidth, LONG& srcHeight, LONG dstWidth, LONG dstHeight, bool dryRun)
+	Resource* Resource::downscale(Resource*& rt, LONG& srcWidth, LONG& srcHeight, LONG dstWidth, LONG dstHeight,
+		bool hasFinalTarget)
 	{
-		while (srcWidth > 2 * dstWidth || srcHeight > 2 * dstHeight)
+		const auto& chain = getDownscaleChain(rt, { srcWidth, srcHeight }, { dstWidth, dstHeight }, hasFinalTarget);
+		auto& repo = SurfaceRepository::get(m_device.getAdapter());
+		std::array<Resource*, 2> rts = {};
+		for (UINT i = 0; i < rts.size(); ++i)
 		{
-			const LONG newSrcWidth = max(dstWidth, (srcWidth + 1) / 2);
-			const LONG newSrcHeight = max(dstHeight, (srcHeight + 1) / 2);
-			auto& nextRt = getNextRenderTarget(rt, newSrcWidth, newSrcHeight);
-			if (!nextRt.resource)
+			if (0 != chain.rtSizes[i].cx)
 			{
-				return;
+				rts[i] = repo.getTempRenderTarget(chain.rtSizes[i].cx, chain.rtSizes[i].cy, i).resource;
 			}
+		}
 
-			if (!dryRun)
+		UINT rtIndex = chain.firstRtIndex;
+		for (const auto& pass : chain.passes)
+		{
+			if (!rts[rtIndex])
 			{
-				m_device.getShaderBlitter().textureBlt(*nextRt.resource, 0, { 0, 0, newSrcWidth, newSrcHeight },
-					*rt, 0, { 0, 0, srcWidth, srcHeight }, D3DTEXF_LINEAR);
+				return nullptr;
 			}
-			rt = nextRt.resource;
-			srcWidth = newSrcWidth;
-			srcHeight = newSrcHeight;
+
+			m_device.getShaderBlitter().textureBlt(*rts[rtIndex], 0, { 0, 0, pass.cx, pass.cy },
+				*rt, 0, { 0, 0, srcWidth, srcHeight }, D3DTEXF_LINEAR);
+			rt = rts[rtIndex];
+			srcWidth = pass.cx;
+			srcHeight = pass.cy;
+			rtIndex = 1 - rtIndex;
+		}
+		return hasFinalTarget ? rts[rtIndex] : nullptr;
+	}
+
+	void Resource::endFrame()
+	{
+		LOG_DEBUG << "Lock surface bytes copied: " << g_copyStats.vidMemBytes << " of " << g_copyStats.vidMemFullBytes
+			<< " to video memory, " << g_copyStats.sysMemBytes << " of " << g_copyStats.sysMemFullBytes
+			<< " to system memory; readbacks: " << g_copyStats.readbackHits << " prefetched, "
+			<< g_copyStats.readbackMisses << " stalled, " << g_copyStats.readbackWaste
+			<< " wasted; forced full refreshes: " << g_copyStats.forcedRefreshes;
+		g_copyStats = {};
+		LOG_DEBUG << MemoryUsage::getSummary();
+	}
+
+	bool Resource::expandPalettizedTexture(const RECT& rect, const RGBQUAD* palette)
+	{
+		if (IsRectEmpty(&rect))
+		{
+			return true;
+		}
+
+		if (4 != m_formatInfo.bytesPerPixel && D3DDDIFMT_R5G6B5 != m_fixedData.Format)
+		{
+			return false;
+		}
+
+		D3DDDIARG_LOCK srcLock = {};
+		srcLock.hResource = *m_palettizedTexture;
+		srcLock.Area = rect;
+		srcLock.Flags.AreaValid = 1;
+		srcLock.Flags.ReadOnly = 1;
+		if (FAILED(m_palettizedTexture->lock(srcLock)))
+		{
+			return false;
+		}
+
+		D3DDDIARG_LOCK dstLock = {};
+		dstLock.hResource = m_handle;
+		dstLock.Area = rect;
+		dstLock.Flags.AreaValid = 1;
+		HRESULT result = lock(dstLock);
+		if (SUCCEEDED(result))
+		{
+			DDraw::Blitter::expandPalette(dstLock.pSurfData, dstLock.Pitch, srcLock.pSurfData, srcLock.Pitch,
+				rect.right - rect.left, rect.bottom - rect.top, m_formatInfo.bytesPerPixel, palette);
+
+			D3DDDIARG_UNLOCK dstUnlock = {};
+			dstUnlock.hResource = dstLock.hResource;
+			unlock(dstUnlock);
 		}
+
+		D3DDDIARG_UNLOCK srcUnlock = {};
+		srcUnlock.hResource = srcLock.hResource;
+		m_palettizedTexture->unlock(srcUnlock);
+		return SUCCEEDED(result);
 	}
 
 	void Resource::fixResourceData()
@@ -745,6 +960,90 @@ namespace D3dDdi
 		}
 	}
 
+	UINT64 Resource::getConfigMemoryUsage(const std::pair<D3DDDIMULTISAMPLE_TYPE, UINT>& msaa,
+		D3DDDIFORMAT formatConfig, SIZE scaledSize)
+	{
+		const LONG width = m_fixedData.pSurfList[0].Width;
+		const LONG height = m_fixedData.pSurfList[0].Height;
+		const bool isScaled = width != scaledSize.cx || height != scaledSize.cy;
+		if (D3DDDIMULTISAMPLE_NONE == msaa.first && m_fixedData.Format == formatConfig && !isScaled)
+		{
+			return 0;
+		}
+
+		const UINT64 scaledSurfaceSize = static_cast<UINT64>(scaledSize.cx) * scaledSize.cy *
+			getFormatInfo(formatConfig).bytesPerPixel * m_fixedData.SurfCount;
+		UINT64 size = scaledSurfaceSize;
+		if (D3DDDIMULTISAMPLE_NONE != msaa.first)
+		{
+			size += scaledSurfaceSize * getSampleCount(msaa);
+		}
+		if (!m_fixedData.Flags.ZBuffer)
+		{
+			size += static_cast<UINT64>(width) * height * m_formatInfo.bytesPerPixel * m_fixedData.SurfCount;
+		}
+		return size;
+	}
+
+	const Resource::DownscaleChain& Resource::getDownscaleChain(
+		Resource* src, SIZE srcSize, SIZE dstSize, bool hasFinalTarget)
+	{
+		auto& repo = SurfaceRepository::get(m_device.getAdapter());
+		const bool isSrcTempRt = repo.isTempRenderTarget(src, 0);
+		auto it = std::find_if(m_downscaleChains.begin(), m_downscaleChains.end(), [&](const DownscaleChain& chain)
+			{
+				return chain.srcSize == srcSize && chain.dstSize == dstSize &&
+					chain.isSrcTempRt == isSrcTempRt && chain.hasFinalTarget == hasFinalTarget;
+			});
+		if (it != m_downscaleChains.end())
+		{
+			return *it;
+		}
+
+		DownscaleChain chain = {};
+		chain.srcSize = srcSize;
+		chain.dstSize = dstSize;
+		chain.isSrcTempRt = isSrcTempRt;
+		chain.hasFinalTarget = hasFinalTarget;
+		chain.firstRtIndex = isSrcTempRt ? 1 : 0;
+
+		auto reserve = [&](UINT rtIndex, SIZE size)
+			{
+				chain.rtSizes[rtIndex].cx = std::max<LONG>(chain.rtSizes[rtIndex].cx, size.cx);
+				chain.rtSizes[rtIndex].cy = std::max<LONG>(chain.rtSizes[rtIndex].cy, size.cy);
+			};
+
+		UINT rtIndex = chain.firstRtIndex;
+		SIZE size = srcSize;
+		while (size.cx > 2 * dstSize.cx || size.cy > 2 * dstSize.cy)
+		{
+			size = { std::max<LONG>(dstSize.cx, (size.cx + 1) / 2), std::max<LONG>(dstSize.cy, (size.cy + 1) / 2) };
+			chain.passes.push_back(size);
+			reserve(rtIndex, size);
+			rtIndex = 1 - rtIndex;
+		}
+
+		if (hasFinalTarget)
+		{
+			reserve(rtIndex, dstSize);
+		}
+
+		for (UINT i = 0; i < chain.rtSizes.size(); ++i)
+		{
+			if (0 != chain.rtSizes[i].cx)
+			{
+				repo.getTempRenderTarget(chain.rtSizes[i].cx, chain.rtSizes[i].cy, i);
+			}
+		}
+
+		if (m_downscaleChains.size() >= MAX_DOWNSCALE_CHAINS)
+		{
+			m_downscaleChains.erase(m_downscaleChains.begin());
+		}
+		m_downscaleChains.push_back(std::move(chain));
+		return m_downscaleChains.back();
+	}
+
 	D3DDDIFORMAT Resource::getFormatConfig()
 	{
 		if (D3DDDIFMT_X8R8G8B8 == m_fixedData.Format || D3DDDIFMT_R5G6B5 == m_fixedData.Format)
@@ -773,23 +1072,17 @@ namespace D3dDdi
 		return { D3DDDIMULTISAMPLE_NONE, 0 };
 	}
 
-	const SurfaceRepository::Surface& Resource::getNextRenderTarget(Resource* currentRt, DWORD width, DWORD height)
-	{
-		auto& repo = SurfaceRepository::get(m_device.getAdapter());
-		auto nextRt = &repo.getTempRenderTarget(width, height, 0);
-		if (nextRt->resource == currentRt)
-		{
-			nextRt = &repo.getTempRenderTarget(width, height, 1);
-		}
-		return *nextRt;
-	}
-
 	RECT Resource::getRect(UINT subResourceIndex)
 	{
 		const auto& si = m_fixedData.pSurfList[subResourceIndex];
 		return { 0, 0, static_cast<LONG>(si.Width), static_cast<LONG>(si.Height) };
 	}
 
+	UINT64 Resource::getRectSize(const RECT& rect)
+	{
+		return static_cast<UINT64>(rect.right - rect.left) * (rect.bottom - rect.top) * m_formatInfo.bytesPerPixel;
+	}
+
 	SIZE Resource::getScaledSize()
 	{
 		SIZE size = { static_cast<LONG>(m_fixedData.pSurfList[0].Width), static_cast<LONG>(m_fixedData.pSurfList[0].Height) };
@@ -800,6 +1093,29 @@ namespace D3dDdi
 		return size;
 	}
 
+	void Resource::invalidatePalettizedTexture()
+	{
+		invalidatePalettizedTexture(getRect(0));
+	}
+
+	void Resource::invalidatePalettizedTexture(const RECT& rect)
+	{
+		m_isPalettizedTextureUpToDate = false;
+		if (D3DDDIFMT_P8 == m_origData.Format)
+		{
+			const RECT surfaceRect = getRect(0);
+			RECT r = {};
+			IntersectRect(&r, &rect, &surfaceRect);
+			UnionRect(&m_palettizedTextureDirtyRect, &m_palettizedTextureDirtyRect, &r);
+		}
+	}
+
+	bool Resource::isDirtyRectTrackingBypassed(UINT subResourceIndex)
+	{
+		// Writes through a lock that is still held when presenting are not covered by the dirty rects yet
+		return subResourceIndex >= m_dirtyRects.size() || 0 != m_lockData[subResourceIndex].lockCount;
+	}
+
 	bool Resource::isValidRect(UINT subResourceIndex, const RECT& rect)
 	{
 		return rect.left >= 0 && rect.top >= 0 && rect.left < rect.right && rect.top < rect.bottom &&
@@ -923,10 +1239,21 @@ namespace D3dDdi
 	{
 		if (!m_lockData[subResourceIndex].isSysMemUpToDate)
 		{
-			loadVidMemResource(subResourceIndex);
-			copySubResource(m_lockResource.get(), *this, subResourceIndex);
+			if (!m_lockData[subResourceIndex].isReadbackPending)
+			{
+				copyToSysMemResource(subResourceIndex);
+			}
 			notifyLock(subResourceIndex);
 			m_lockData[subResourceIndex].isSysMemUpToDate = true;
+			m_lockData[subResourceIndex].isReadbackPending = false;
+			if (subResourceIndex < m_dirtyRects.size())
+			{
+				m_dirtyRects[subResourceIndex].clear();
+			}
+			if (subResourceIndex < m_vidMemDirtyRects.size())
+			{
+				m_vidMemDirtyRects[subResourceIndex].clear();
+			}
 		}
 	}
 
@@ -938,6 +1265,12 @@ namespace D3dDdi
 		}
 		m_lockData[subResourceIndex].isVidMemUpToDate = true;
 
+		std::vector<RECT> dirtyRects;
+		if (subResourceIndex < m_dirtyRects.size())
+		{
+			dirtyRects.swap(m_dirtyRects[subResourceIndex]);
+		}
+
 		if (m_lockData[subResourceIndex].isMsaaUpToDate || m_lockData[subResourceIndex].isMsaaResolvedUpToDate)
 		{
 			loadMsaaResolvedResource(subResourceIndex);
@@ -969,21 +1302,17 @@ namespace D3dDdi
 			auto dstRect = getRect(subResourceIndex);
 
 			SurfaceRepository::enableSurfaceCheck(false);
-			downscale(src, srcRect.right, srcRect.bottom, dstRect.right, dstRect.bottom);
+			auto nextRt = downscale(src, srcRect.right, srcRect.bottom, dstRect.right, dstRect.bottom,
+				!(m_device.getAdapter().getInfo().formatOps.at(m_fixedData.Format).Operations & FORMATOP_SRGBWRITE));
 			auto srcIndex = src == m_msaaResolvedSurface.resource ? subResourceIndex : 0;
 
-			if (dstRect != srcRect &&
-				!(m_device.getAdapter().getInfo().formatOps.at(m_fixedData.Format).Operations & FORMATOP_SRGBWRITE))
+			if (dstRect != srcRect && nextRt)
 			{
-				auto nextRt = getNextRenderTarget(src, dstRect.right, dstRect.bottom).resource;
-				if (nextRt)
-				{
-					m_device.getShaderBlitter().textureBlt(*nextRt, 0, dstRect,
-						*src, srcIndex, srcRect, D3DTEXF_LINEAR);
-					src = nextRt;
-					srcRect = dstRect;
-					srcIndex = 0;
-				}
+				m_device.getShaderBlitter().textureBlt(*nextRt, 0, dstRect,
+					*src, srcIndex, srcRect, D3DTEXF_LINEAR);
+				src = nextRt;
+				srcRect = dstRect;
+				srcIndex = 0;
 			}
 			SurfaceRepository::enableSurfaceCheck(true);
 
@@ -997,9 +1326,23 @@ namespace D3dDdi
 					*src, srcIndex, srcRect, D3DTEXF_LINEAR);
 			}
 		}
+		else if (subResourceIndex < m_dirtyRects.size())
+		{
+			for (const auto& rect : dirtyRects)
+			{
+				copySubResourceRegion(m_handle, subResourceIndex, rect, m_lockResource.get(), subResourceIndex, rect);
+				g_copyStats.vidMemBytes += getRectSize(rect);
+			}
+			g_copyStats.vidMemFullBytes += getRectSize(getRect(subResourceIndex));
+			notifyLock(subResourceIndex);
+			m_lockData[subResourceIndex].isRefLocked = false;
+		}
 		else
 		{
 			copySubResource(*this, m_lockResource.get(), subResourceIndex);
+			const UINT64 size = getRectSize(getRect(subResourceIndex));
+			g_copyStats.vidMemBytes += size;
+			g_copyStats.vidMemFullBytes += size;
 			notifyLock(subResourceIndex);
 			m_lockData[subResourceIndex].isRefLocked = false;
 		}
@@ -1026,7 +1369,7 @@ namespace D3dDdi
 
 		if (!data.Flags.ReadOnly)
 		{
-			m_isPalettizedTextureUpToDate = false;
+			invalidatePalettizedTexture(data.Flags.AreaValid ? data.Area : getRect(data.SubResourceIndex));
 		}
 
 		if (m_fixedData.Flags.ZBuffer && m_msaaResolvedSurface.resource)
@@ -1066,6 +1409,69 @@ namespace D3dDdi
 		}
 	}
 
+	void Resource::predictReadback(UINT subResourceIndex)
+	{
+		auto& lockData = m_lockData[subResourceIndex];
+		const UINT gpuWriteCount = lockData.gpuWriteCount;
+		lockData.gpuWriteCount = 0;
+		if (lockData.isSysMemUpToDate)
+		{
+			return;
+		}
+
+		if (lockData.isReadbackPending)
+		{
+			++g_copyStats.readbackHits;
+		}
+		else
+		{
+			++g_copyStats.readbackMisses;
+		}
+
+		if (Config::Settings::AsyncReadback::ON == Config::asyncReadback.get())
+		{
+			lockData.qpcLastForcedLock = Time::queryPerformanceCounter();
+			lockData.predictedGpuWriteCount = gpuWriteCount;
+			m_device.addReadbackResource(*this);
+		}
+	}
+
+	bool Resource::prefetchReadback()
+	{
+		if (!m_lockResource)
+		{
+			return false;
+		}
+
+		const long long qpcNow = Time::queryPerformanceCounter();
+		bool isPredicted = false;
+		for (UINT i = 0; i < m_lockData.size(); ++i)
+		{
+			auto& lockData = m_lockData[i];
+			if (0 == lockData.qpcLastForcedLock)
+			{
+				continue;
+			}
+
+			if (qpcNow - lockData.qpcLastForcedLock > Time::g_qpcFrequency * READBACK_PREDICTION_MS / 1000)
+			{
+				lockData.qpcLastForcedLock = 0;
+				continue;
+			}
+
+			isPredicted = true;
+			// The lock is expected after as many GPU writes as there were before the previous one
+			if (!lockData.isSysMemUpToDate && !lockData.isReadbackPending &&
+				lockData.gpuWriteCount >= lockData.predictedGpuWriteCount)
+			{
+				m_device.flushPrimitives();
+				copyToSysMemResource(i);
+				lockData.isReadbackPending = true;
+			}
+		}
+		return isPredicted;
+	}
+
 	Resource& Resource::prepareForBltSrc(const D3DDDIARG_BLT& data)
 	{
 		if (m_lockResource || m_msaaResolvedSurface.resource)
@@ -1082,10 +1488,11 @@ namespace D3dDdi
 
 	Resource& Resource::prepareForBltDst(HANDLE& resource, UINT subResourceIndex, RECT& rect)
 	{
-		m_isPalettizedTextureUpToDate = false;
+		invalidatePalettizedTexture(rect);
 		if (m_lockResource || m_msaaResolvedSurface.resource)
 		{
 			loadFromLockRefResource(subResourceIndex);
+			++m_lockData[subResourceIndex].gpuWriteCount;
 			if (m_lockData[subResourceIndex].isMsaaUpToDate)
 			{
 				resource = *m_msaaSurface.resource;
@@ -1105,8 +1512,7 @@ namespace D3dDdi
 			else
 			{
 				loadVidMemResource(subResourceIndex);
-				clearUpToDateFlags(subResourceIndex);
-				m_lockData[subResourceIndex].isVidMemUpToDate = true;
+				addVidMemDirtyRect(subResourceIndex, rect);
 			}
 		}
 		return *this;
@@ -1116,6 +1522,7 @@ namespace D3dDdi
 	{
 		if (m_lockResource)
 		{
+			predictReadback(subResourceIndex);
 			loadSysMemResource(subResourceIndex);
 		}
 	}
@@ -1178,6 +1585,7 @@ namespace D3dDdi
 				clearUpToDateFlags(subResourceIndex);
 				m_lockData[subResourceIndex].isVidMemUpToDate = true;
 			}
+			++m_lockData[subResourceIndex].gpuWriteCount;
 		}
 	}
 
@@ -1187,10 +1595,13 @@ namespace D3dDdi
 		if (srcResource->m_lockResource)
 		{
 			if (srcResource->m_lockData[data.SrcSubResourceIndex].isSysMemUpToDate &&
-				!srcResource->m_fixedData.Flags.RenderTarget)
+				!srcResource->m_fixedData.Flags.RenderTarget &&
+				srcResource->isDirtyRectTrackingBypassed(data.SrcSubResourceIndex))
 			{
 				srcResource->m_lockData[data.SrcSubResourceIndex].isVidMemUpToDate = false;
 				srcResource->m_lockData[data.SrcSubResourceIndex].isMsaaResolvedUpToDate = false;
+				srcResource->addDirtyRect(data.SrcSubResourceIndex, srcResource->getRect(data.SrcSubResourceIndex));
+				++g_copyStats.forcedRefreshes;
 			}
 
 			srcResource = &srcResource->prepareForGpuRead(data.SrcSubResourceIndex);
@@ -1257,16 +1668,10 @@ namespace D3dDdi
 
 		const LONG dstWidth = data.DstRect.right - data.DstRect.left;
 		const LONG dstHeight = data.DstRect.bottom - data.DstRect.top;
-		downscale(rt, data.SrcRect.right, data.SrcRect.bottom, dstWidth, dstHeight);
-
-		const SurfaceRepository::Surface* rtGamma = nullptr;
-		if (!ShaderBlitter::isGammaRampDefault() &&
-			SurfaceRepository::get(m_device.getAdapter()).getGammaRampTexture())
-		{
-			rtGamma = &getNextRenderTarget(rt, dstWidth, dstHeight);
-		}
-		const bool useGamma = rtGamma && rtGamma->resource;
-		auto& rtNext = useGamma ? *rtGamma->resource : *this;
+		const bool hasGamma = !ShaderBlitter::isGammaRampDefault() && repo.getGammaRampTexture();
+		auto rtGamma = downscale(rt, data.SrcRect.right, data.SrcRect.bottom, dstWidth, dstHeight, hasGamma);
+		const bool useGamma = nullptr != rtGamma;
+		auto& rtNext = useGamma ? *rtGamma : *this;
 		auto rtNextIndex = useGamma ? 0 : data.DstSubResourceIndex;
 		auto rtNextRect = useGamma ? RECT{ 0, 0, dstWidth, dstHeight } : data.DstRect;
 
@@ -1356,6 +1761,28 @@ namespace D3dDdi
 		}
 	}
 
+	void Resource::resetDirtyRects()
+	{
+		m_dirtyRects.clear();
+		m_vidMemDirtyRects.clear();
+		if (m_lockResource)
+		{
+			m_dirtyRects.resize(m_lockData.size());
+			m_vidMemDirtyRects.resize(m_lockData.size());
+			for (UINT i = 0; i < m_lockData.size(); ++i)
+			{
+				if (m_isPrimary || !m_lockData[i].isVidMemUpToDate)
+				{
+					m_dirtyRects[i].assign(1, getRect(i));
+				}
+				if (!m_lockData[i].isSysMemUpToDate)
+				{
+					m_vidMemDirtyRects[i].assign(1, getRect(i));
+				}
+			}
+		}
+	}
+
 	void Resource::resolveMsaaDepthBuffer()
 	{
 		LOG_FUNC("Resource::resolveMsaaDepthBuffer");
@@ -1391,6 +1818,7 @@ namespace D3dDdi
 		{
 			createLockResource();
 		}
+		resetDirtyRects();
 	}
 
 	void Resource::setAsPrimary()
@@ -1399,6 +1827,7 @@ namespace D3dDdi
 		if (!m_isPrimary)
 		{
 			m_isPrimary = true;
+			resetDirtyRects();
 			updateConfig();
 		}
 	}
@@ -1437,13 +1866,13 @@ namespace D3dDdi
 	void Resource::setPaletteHandle(UINT paletteHandle)
 	{
 		m_paletteHandle = paletteHandle;
-		m_isPalettizedTextureUpToDate = false;
+		invalidatePalettizedTexture();
 	}
 
 	void Resource::setPalettizedTexture(Resource& resource)
 	{
 		m_palettizedTexture = &resource;
-		resource.m_isPalettizedTextureUpToDate = false;
+		resource.invalidatePalettizedTexture();
 	}
 
 	HRESULT Resource::shaderBlt(D3DDDIARG_BLT& data, Resource& dstResource, Resource& srcResource)
@@ -1551,6 +1980,11 @@ namespace D3dDdi
 
 	HRESULT Resource::unlock(const D3DDDIARG_UNLOCK& data)
 	{
+		if (m_lockResource && data.SubResourceIndex < m_lockData.size() &&
+			0 != m_lockData[data.SubResourceIndex].lockCount)
+		{
+			--m_lockData[data.SubResourceIndex].lockCount;
+		}
 		return (m_lockResource || m_isOversized) ? S_OK : m_device.getOrigVtable().pfnUnlock(m_device, &data);
 	}
 
@@ -1564,9 +1998,10 @@ namespace D3dDdi
 			return;
 		}
 
-		const auto msaa = getMultisampleConfig();
+		auto msaa = getMultisampleConfig();
 		const auto formatConfig = getFormatConfig();
-		const auto scaledSize = getScaledSize();
+		auto scaledSize = getScaledSize();
+		applyMemoryBudget(msaa, formatConfig, scaledSize);
 		if (m_multiSampleConfig == msaa && m_formatConfig == formatConfig && m_scaledSize == scaledSize)
 		{
 			return;
@@ -1640,18 +2075,18 @@ namespace D3dDdi
 				
 				if (isScaled)
 				{
-					Resource* rt = m_msaaResolvedSurface.resource;
-					auto srcRect = rt->getRect(0);
-					auto dstRect = getRect(0);
-					const bool dryRun = true;
-					downscale(rt, srcRect.right, srcRect.bottom, dstRect.right, dstRect.bottom, dryRun);
-					if (dstRect != srcRect &&
-						!(m_device.getAdapter().getInfo().formatOps.at(m_fixedData.Format).Operations & FORMATOP_SRGBWRITE))
-					{
-						getNextRenderTarget(rt, dstRect.right, dstRect.bottom);
-					}
+					const auto srcRect = m_msaaResolvedSurface.resource->getRect(0);
+					const auto dstRect = getRect(0);
+					getDownscaleChain(m_msaaResolvedSurface.resource, { srcRect.right, srcRect.bottom },
+						{ dstRect.right, dstRect.bottom },
+						!(m_device.getAdapter().getInfo().formatOps.at(m_fixedData.Format).Operations & FORMATOP_SRGBWRITE));
 				}
 			}
+
+			setMemoryUsageCategory(m_msaaSurface, MemoryUsage::MSAA, getSampleCount(msaa));
+			setMemoryUsageCategory(m_nullSurface, MemoryUsage::NULL_SURFACE, getSampleCount(msaa));
+			setMemoryUsageCategory(m_msaaResolvedSurface, MemoryUsage::MSAA_RESOLVED);
+			setMemoryUsageCategory(m_lockRefSurface, MemoryUsage::LOCK_REF);
 		}
 	}
 
@@ -1688,8 +2123,20 @@ namespace D3dDdi
 		}
 
 		auto rect = getRect(0);
-		m_device.getShaderBlitter().palettizedBlt(*this, 0, rect, *m_palettizedTexture, 0, rect, palettePtr);
+		auto& dirtyRect = m_palettizedTexture->m_palettizedTextureDirtyRect;
+		if (paletteColorKeyIndex != m_paletteColorKeyIndex)
+		{
+			dirtyRect = rect;
+		}
+
+		const bool useCpu = Config::Settings::PalettizedTextures::CPU == Config::palettizedTextures.get() ||
+			&IID_IDirect3DHALDevice == Config::softwareDevice.get();
+		if (!useCpu || !expandPalettizedTexture(dirtyRect, palettePtr))
+		{
+			m_device.getShaderBlitter().palettizedBlt(*this, 0, rect, *m_palettizedTexture, 0, rect, palettePtr);
+		}
 
+		dirtyRect = {};
 		m_palettizedTexture->m_isPalettizedTextureUpToDate = true;
 		m_paletteColorKeyIndex = paletteColorKeyIndex;
 	}
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <vector>
 
@@ -25,6 +26,8 @@ namespace D3dDdi
 		Resource& operator=(Resource&&) = delete;
 		~Resource();
 
+		static void endFrame();
+
 		operator HANDLE() const { return m_handle; }
 		const Resource* getCustomResource() { return m_msaaSurface.resource ? m_msaaSurface.resource : m_msaaResolvedSurface.resource; }
 		Device& getDevice() const { return m_device; }
@@ -33,12 +36,13 @@ namespace D3dDdi
 		UINT getPaletteHandle() const { return m_paletteHandle; }
 		Resource* getPalettizedTexture() { return m_palettizedTexture; }
 		bool isClampable() const { return m_isClampable; }
-		void invalidatePalettizedTexture() { m_isPalettizedTextureUpToDate = false; }
 
+		void addDirtyRect(UINT subResourceIndex, const RECT& rect);
 		HRESULT blt(D3DDDIARG_BLT data);
 		HRESULT colorFill(D3DDDIARG_COLORFILL data);
 		void disableClamp();
 		void* getLockPtr(UINT subResourceIndex);
+		void invalidatePalettizedTexture();
 		HRESULT lock(D3DDDIARG_LOCK& data);
 		void onDestroyResource(HANDLE resource);
 		Resource& prepareForBltSrc(const D3DDDIARG_BLT& data);
@@ -48,6 +52,7 @@ namespace D3dDdi
 		void prepareForCpuWrite(UINT subResourceIndex);
 		Resource& prepareForGpuRead(UINT subResourceIndex);
 		void prepareForGpuWrite(UINT subResourceIndex);
+		bool prefetchReadback();
 		HRESULT presentationBlt(D3DDDIARG_BLT data, Resource* srcResource);
 		void scaleRect(RECT& rect);
 		void setAsGdiResource(bool isGdiResource);
@@ -78,19 +83,37 @@ namespace D3dDdi
 			void* data;
 			UINT pitch;
 			UINT lockCount;
+			UINT gpuWriteCount;
+			UINT predictedGpuWriteCount;
 			long long qpcLastForcedLock;
 			bool isSysMemUpToDate;
 			bool isVidMemUpToDate;
 			bool isMsaaUpToDate;
 			bool isMsaaResolvedUpToDate;
 			bool isRefLocked;
+			bool isReadbackPending;
 
 			LockData() { memset(this, 0, sizeof(*this)); }
 		};
 
+		struct DownscaleChain
+		{
+			SIZE srcSize;
+			SIZE dstSize;
+			bool isSrcTempRt;
+			bool hasFinalTarget;
+			std::vector<SIZE> passes;
+			std::array<SIZE, 2> rtSizes;
+			UINT firstRtIndex;
+		};
+
+		void addDirtyRect(std::vector<RECT>& dirtyRects, UINT subResourceIndex, const RECT& rect);
+		void addVidMemDirtyRect(UINT subResourceIndex, const RECT& rect);
+		void applyMemoryBudget(std::pair<D3DDDIMULTISAMPLE_TYPE, UINT>& msaa, D3DDDIFORMAT formatConfig, SIZE& scaledSize);
 		HRESULT bltLock(D3DDDIARG_LOCK& data);
 		HRESULT bltViaCpu(D3DDDIARG_BLT data, Resource& srcResource);
 		HRESULT bltViaGpu(D3DDDIARG_BLT data, Resource& srcResource);
+		void cancelReadback(UINT subResourceIndex);
 		void clearRectExterior(UINT subResourceIndex, const RECT& rect);
 		void clearRectInterior(UINT subResourceIndex, const RECT& rect);
 		void clearUpToDateFlags(UINT subResourceIndex);
@@ -99,16 +122,24 @@ namespace D3dDdi
 		HRESULT copySubResource(HANDLE dstResource, HANDLE srcResource, UINT subResourceIndex);
 		HRESULT copySubResourceRegion(HANDLE dst, UINT dstIndex, const RECT& dstRect,
 			HANDLE src, UINT srcIndex, const RECT& srcRect);
+		void copyToSysMemResource(UINT subResourceIndex);
 		void createGdiLockResource();
 		void createLockResource();
 		void createSysMemResource(const std::vector<D3DDDI_SURFACEINFO>& surfaceInfo);
-		void downscale(Resource*& rt, LONG& srcWidth, LONG& srcHeight, LONG dstWidth, LONG dstHeight, bool dryRun = false);
+		Resource* downscale(Resource*& rt, LONG& srcWidth, LONG& srcHeight, LONG dstWidth, LONG dstHeight,
+			bool hasFinalTarget = false);
+		bool expandPalettizedTexture(const RECT& rect, const RGBQUAD* palette);
 		void fixResourceData();
+		UINT64 getConfigMemoryUsage(const std::pair<D3DDDIMULTISAMPLE_TYPE, UINT>& msaa,
+			D3DDDIFORMAT formatConfig, SIZE scaledSize);
+		const DownscaleChain& getDownscaleChain(Resource* src, SIZE srcSize, SIZE dstSize, bool hasFinalTarget);
 		D3DDDIFORMAT getFormatConfig();
 		std::pair<D3DDDIMULTISAMPLE_TYPE, UINT> getMultisampleConfig();
-		const SurfaceRepository::Surface& getNextRenderTarget(Resource* currentRt, DWORD width, DWORD height);
 		RECT getRect(UINT subResourceIndex);
+		UINT64 getRectSize(const RECT& rect);
 		SIZE getScaledSize();
+		void invalidatePalettizedTexture(const RECT& rect);
+		bool isDirtyRectTrackingBypassed(UINT subResourceIndex);
 		bool isValidRect(UINT subResourceIndex, const RECT& rect);
 		void loadFromLockRefResource(UINT subResourceIndex);
 		void loadMsaaResource(UINT subResourceIndex);
@@ -116,7 +147,9 @@ namespace D3dDdi
 		void loadSysMemResource(UINT subResourceIndex);
 		void loadVidMemResource(UINT subResourceIndex);
 		void notifyLock(UINT subResourceIndex);
+		void predictReadback(UINT subResourceIndex);
 		void presentLayeredWindows(Resource& dst, UINT dstSubResourceIndex, const RECT& dstRect);
+		void resetDirtyRects();
 		void resolveMsaaDepthBuffer();
 		HRESULT shaderBlt(D3DDDIARG_BLT& data, Resource& dstResource, Resource& srcResource);
 
@@ -127,6 +160,9 @@ namespace D3dDdi
 		FormatInfo m_formatInfo;
 		std::unique_ptr<void, void(*)(void*)> m_lockBuffer;
 		std::vector<LockData> m_lockData;
+		std::vector<std::vector<RECT>> m_dirtyRects;
+		std::vector<std::vector<RECT>> m_vidMemDirtyRects;
+		std::vector<DownscaleChain> m_downscaleChains;
 		std::unique_ptr<void, ResourceDeleter> m_lockResource;
 		SurfaceRepository::Surface m_lockRefSurface;
 		SurfaceRepository::Surface m_msaaSurface;
@@ -138,6 +174,7 @@ namespace D3dDdi
 		Resource* m_palettizedTexture;
 		UINT m_paletteHandle;
 		int m_paletteColorKeyIndex;
+		RECT m_palettizedTextureDirtyRect;
 		bool m_isOversized;
 		bool m_isSurfaceRepoResource;
 		bool m_isClampable;
@@ -0,0 +1,136 @@
+#include <cstring>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#else
+#include <immintrin.h>
+#endif
+
+#include <D3dDdi/SpriteKernels.h>
+
+namespace
+{
+	using D3dDdi::SpriteKernels::MASK_BITS;
+
+	UINT countTrailingZeros(UINT value)
+	{
+#ifdef _MSC_VER
+		unsigned long index = 0;
+		_BitScanForward(&index, value);
+		return index;
+#else
+		return __builtin_ctz(value);
+#endif
+	}
+
+	float loadFloat(const BYTE* base, UINT stride, const UINT16* indices, UINT i)
+	{
+		float value = 0;
+		memcpy(&value, base + (indices ? indices[i] : i) * stride, sizeof(value));
+		return value;
+	}
+
+	__m128 loadTexCoord(const BYTE* texCoords, UINT stride, const UINT16* indices, UINT i)
+	{
+		return _mm_castsi128_ps(_mm_loadl_epi64(
+			reinterpret_cast<const __m128i*>(texCoords + (indices ? indices[i] : i) * stride)));
+	}
+
+	__m128 loadZ(const BYTE* z, UINT stride, const UINT16* indices, UINT vertex)
+	{
+		return _mm_setr_ps(
+			loadFloat(z, stride, indices, vertex),
+			loadFloat(z, stride, indices, vertex + 3),
+			loadFloat(z, stride, indices, vertex + 6),
+			loadFloat(z, stride, indices, vertex + 9));
+	}
+}
+
+namespace D3dDdi
+{
+	namespace SpriteKernels
+	{
+		void classifySprites(UINT* mask, const BYTE* z, UINT stride, const UINT16* indices, UINT triangleCount,
+			float maxZ)
+		{
+			memset(mask, 0, getMaskSize(triangleCount) * sizeof(UINT));
+			const __m128 maxZ4 = _mm_set1_ps(maxZ);
+
+			UINT i = 0;
+			for (; i + 4 <= triangleCount; i += 4)
+			{
+				const __m128 z0 = loadZ(z, stride, indices, i * 3);
+				const __m128 z1 = loadZ(z, stride, indices, i * 3 + 1);
+				const __m128 z2 = loadZ(z, stride, indices, i * 3 + 2);
+				const __m128 isSprite = _mm_and_ps(_mm_and_ps(_mm_cmpeq_ps(z0, z1), _mm_cmpeq_ps(z0, z2)),
+					_mm_cmple_ps(z0, maxZ4));
+				mask[i / MASK_BITS] |= static_cast<UINT>(_mm_movemask_ps(isSprite)) << (i % MASK_BITS);
+			}
+
+			for (; i < triangleCount; ++i)
+			{
+				const float z0 = loadFloat(z, stride, indices, i * 3);
+				const bool isSprite = z0 == loadFloat(z, stride, indices, i * 3 + 1) &&
+					z0 == loadFloat(z, stride, indices, i * 3 + 2) && z0 <= maxZ;
+				mask[i / MASK_BITS] |= static_cast<UINT>(isSprite) << (i % MASK_BITS);
+			}
+		}
+
+		UINT getMaskSize(UINT count)
+		{
+			return (count + MASK_BITS - 1) / MASK_BITS;
+		}
+
+		UINT getRunEnd(const UINT* mask, UINT first, UINT count)
+		{
+			const UINT invert = isSet(mask, first) ? ~0U : 0;
+			UINT i = first / MASK_BITS;
+			UINT word = (mask[i] ^ invert) & (~0U << first % MASK_BITS);
+			const UINT size = getMaskSize(count);
+			while (0 == word && ++i < size)
+			{
+				word = mask[i] ^ invert;
+			}
+
+			if (0 == word)
+			{
+				return count;
+			}
+			const UINT end = i * MASK_BITS + countTrailingZeros(word);
+			return end < count ? end : count;
+		}
+
+		bool isTexCoordInRange(const BYTE* texCoords, UINT stride, const UINT16* indices, UINT count,
+			float minU, float maxU, float minV, float maxV)
+		{
+			const __m128 minUv = _mm_setr_ps(minU, minV, minU, minV);
+			const __m128 maxUv = _mm_setr_ps(maxU, maxV, maxU, maxV);
+
+			UINT i = 0;
+			for (; i + 4 <= count; i += 4)
+			{
+				const __m128 uv01 = _mm_movelh_ps(
+					loadTexCoord(texCoords, stride, indices, i), loadTexCoord(texCoords, stride, indices, i + 1));
+				const __m128 uv23 = _mm_movelh_ps(
+					loadTexCoord(texCoords, stride, indices, i + 2), loadTexCoord(texCoords, stride, indices, i + 3));
+				const __m128 outOfRange = _mm_or_ps(
+					_mm_or_ps(_mm_cmplt_ps(uv01, minUv), _mm_cmpgt_ps(uv01, maxUv)),
+					_mm_or_ps(_mm_cmplt_ps(uv23, minUv), _mm_cmpgt_ps(uv23, maxUv)));
+				if (0 != _mm_movemask_ps(outOfRange))
+				{
+					return false;
+				}
+			}
+
+			for (; i < count; ++i)
+			{
+				const __m128 uv = loadTexCoord(texCoords, stride, indices, i);
+				if (0 != (_mm_movemask_ps(_mm_or_ps(_mm_cmplt_ps(uv, minUv), _mm_cmpgt_ps(uv, maxUv))) & 3))
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <Common/Portability.h>
+
+namespace D3dDdi
+{
+	namespace SpriteKernels
+	{
+		const UINT MASK_BITS = 32;
+
+		// Sets bit i of mask if triangle i (vertices 3i, 3i+1, 3i+2) has a constant z not greater than maxZ.
+		// z points to the z coordinate of vertex 0, indices is null for non-indexed triangle lists.
+		void classifySprites(UINT* mask, const BYTE* z, UINT stride, const UINT16* indices, UINT triangleCount,
+			float maxZ);
+		UINT getMaskSize(UINT count);
+		UINT getRunEnd(const UINT* mask, UINT first, UINT count);
+		bool isTexCoordInRange(const BYTE* texCoords, UINT stride, const UINT16* indices, UINT count,
+			float minU, float maxU, float minV, float maxV);
+
+		inline bool isSet(const UINT* mask, UINT index)
+		{
+			return 0 != (mask[index / MASK_BITS] & (1U << index % MASK_BITS));
+		}
+
+		// Calls func(first, end, isSet) for each run of equal bits in the first count bits of mask
+		template <typename Func>
+		void forEachRun(const UINT* mask, UINT count, Func func)
+		{
+			UINT first = 0;
+			while (first < count)
+			{
+				const UINT end = getRunEnd(mask, first, count);
+				func(first, end, isSet(mask, first));
+				first = end;
+			}
+		}
+	}
+}
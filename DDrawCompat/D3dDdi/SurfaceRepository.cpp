@@ -1,5 +1,6 @@
 #undef WIN32_LEAN_AND_MEAN
 
+#include <algorithm>
 #include <map>
 
 #include <Windows.h>
@@ -15,8 +16,31 @@
 
 namespace
 {
+	const DWORD MIN_SIZE_CLASS = 64;
+	const UINT64 SURFACE_POOL_BUDGET = 64 * 1024 * 1024;
+
 	std::map<LUID, D3dDdi::SurfaceRepository> g_repositories;
 	bool g_enableSurfaceCheck = true;
+
+	UINT64 getSurfaceSize(const D3dDdi::SurfaceRepository::Surface& surface, UINT surfaceCount)
+	{
+		return static_cast<UINT64>(surface.width) * surface.height * surface.pixelFormat.dwRGBBitCount / 8 * surfaceCount;
+	}
+
+	DWORD getSizeClass(DWORD size)
+	{
+		if (size <= MIN_SIZE_CLASS)
+		{
+			return MIN_SIZE_CLASS;
+		}
+
+		DWORD step = MIN_SIZE_CLASS;
+		while (step * 8 < size)
+		{
+			step *= 2;
+		}
+		return (size + step - 1) / step * step;
+	}
 }
 
 namespace D3dDdi
@@ -26,6 +50,10 @@ namespace D3dDdi
 		, m_cursor(nullptr)
 		, m_cursorSize{}
 		, m_cursorHotspot{}
+		, m_surfacePoolTick(0)
+		, m_surfacePoolHits(0)
+		, m_surfacePoolMisses(0)
+		, m_surfacePoolEvictions(0)
 	{
 	}
 
@@ -72,6 +100,30 @@ namespace D3dDdi
 		g_enableSurfaceCheck = enable;
 	}
 
+	void SurfaceRepository::evictPooledSurfaces()
+	{
+		UINT64 poolSize = 0;
+		for (const auto& pooledSurface : m_surfacePool)
+		{
+			poolSize += getSurfaceSize(pooledSurface.surface, pooledSurface.surfaceCount);
+		}
+
+		const bool isOverMemoryBudget = !MemoryUsage::isWithinBudget(0);
+		while (poolSize > SURFACE_POOL_BUDGET || isOverMemoryBudget && !m_surfacePool.empty())
+		{
+			auto lru = std::min_element(m_surfacePool.begin(), m_surfacePool.end(),
+				[](const PooledSurface& lhs, const PooledSurface& rhs) { return lhs.lastUsed < rhs.lastUsed; });
+			poolSize -= getSurfaceSize(lru->surface, lru->surfaceCount);
+			m_releasedSurfaces.push_back(lru->surface);
+			m_surfacePool.erase(lru);
+			++m_surfacePoolEvictions;
+		}
+
+		LOG_DEBUG << "Surface pool: " << m_surfacePool.size() << " surfaces, " << poolSize << " bytes, "
+			<< m_surfacePoolHits << " hits, " << m_surfacePoolMisses << " misses, "
+			<< m_surfacePoolEvictions << " evictions";
+	}
+
 	SurfaceRepository& SurfaceRepository::get(const Adapter& adapter)
 	{
 		auto it = g_repositories.find(adapter.getLuid());
@@ -242,6 +294,8 @@ namespace D3dDdi
 				surface.width = width;
 				surface.height = height;
 				surface.pixelFormat = pf;
+				surface.allocation = std::make_shared<MemoryUsage::Allocation>(
+					MemoryUsage::REPOSITORY, getSurfaceSize(surface, surfaceCount));
 			}
 		}
 
@@ -261,7 +315,55 @@ namespace D3dDdi
 	SurfaceRepository::Surface& SurfaceRepository::getTempSurface(Surface& surface, DWORD width, DWORD height,
 		const DDPIXELFORMAT& pf, DWORD caps, UINT surfaceCount)
 	{
-		return getSurface(surface, max(width, surface.width), max(height, surface.height), pf, caps, surfaceCount);
+		if (!g_enableSurfaceCheck)
+		{
+			return surface;
+		}
+
+		const bool isSamePixelFormat = 0 == memcmp(&surface.pixelFormat, &pf, sizeof(pf));
+		if (surface.surface && surface.width >= width && surface.height >= height && isSamePixelFormat &&
+			!isLost(surface))
+		{
+			return surface;
+		}
+
+		if (surface.surface && isSamePixelFormat && !isLost(surface))
+		{
+			width = max(width, surface.width);
+			height = max(height, surface.height);
+			m_surfacePool.push_back({ surface, caps, surfaceCount, ++m_surfacePoolTick });
+		}
+		surface = {};
+
+		auto best = m_surfacePool.end();
+		for (auto it = m_surfacePool.begin(); it != m_surfacePool.end(); ++it)
+		{
+			if (it->caps == caps && it->surfaceCount == surfaceCount &&
+				it->surface.width >= width && it->surface.height >= height &&
+				0 == memcmp(&it->surface.pixelFormat, &pf, sizeof(pf)) &&
+				(best == m_surfacePool.end() ||
+					it->surface.width * it->surface.height < best->surface.width * best->surface.height))
+			{
+				best = it;
+			}
+		}
+
+		if (best != m_surfacePool.end())
+		{
+			Surface pooledSurface = best->surface;
+			m_surfacePool.erase(best);
+			if (!isLost(pooledSurface))
+			{
+				surface = pooledSurface;
+				++m_surfacePoolHits;
+				return surface;
+			}
+		}
+
+		++m_surfacePoolMisses;
+		getSurface(surface, getSizeClass(width), getSizeClass(height), pf, caps, surfaceCount);
+		evictPooledSurfaces();
+		return surface;
 	}
 
 	SurfaceRepository::Surface& SurfaceRepository::getTempSysMemSurface(DWORD width, DWORD height)
@@ -308,6 +410,11 @@ namespace D3dDdi
 		return !surface.surface || FAILED(surface.surface->IsLost(surface.surface));
 	}
 
+	bool SurfaceRepository::isTempRenderTarget(const Resource* resource, UINT index) const
+	{
+		return resource && index < m_renderTargets.size() && m_renderTargets[index].resource == resource;
+	}
+
 	void SurfaceRepository::release(Surface& surface)
 	{
 		if (surface.surface)
@@ -2,11 +2,13 @@
 
 #include <functional>
 #include <map>
+#include <memory>
 
 #include <ddraw.h>
 
 #include <Common/CompatPtr.h>
 #include <Common/CompatRef.h>
+#include <D3dDdi/MemoryUsage.h>
 #include <DDraw/Comparison.h>
 
 namespace D3dDdi
@@ -34,6 +36,7 @@ namespace D3dDdi
 			DWORD width = 0;
 			DWORD height = 0;
 			DDPIXELFORMAT pixelFormat = {};
+			std::shared_ptr<MemoryUsage::Allocation> allocation;
 		};
 
 		Cursor getCursor(HCURSOR cursor);
@@ -47,6 +50,7 @@ namespace D3dDdi
 		Surface& getTempSurface(Surface& surface, DWORD width, DWORD height,
 			const DDPIXELFORMAT& pf, DWORD caps, UINT surfaceCount = 1);
 		const Surface& getTempTexture(DWORD width, DWORD height, const DDPIXELFORMAT& pf);
+		bool isTempRenderTarget(const Resource* resource, UINT index) const;
 		void release(Surface& surface);
 
 		static SurfaceRepository& get(const Adapter& adapter);
@@ -56,8 +60,17 @@ namespace D3dDdi
 	private:
 		SurfaceRepository(const Adapter& adapter);
 
+		struct PooledSurface
+		{
+			Surface surface;
+			DWORD caps;
+			UINT surfaceCount;
+			UINT64 lastUsed;
+		};
+
 		CompatPtr<IDirectDrawSurface7> createSurface(DWORD width, DWORD height,
 			const DDPIXELFORMAT& pf, DWORD caps, UINT surfaceCount);
+		void evictPooledSurfaces();
 		bool getCursorImage(Surface& surface, HCURSOR cursor, DWORD width, DWORD height, UINT flags);
 		Resource* getInitializedResource(Surface& surface, DWORD width, DWORD height, const DDPIXELFORMAT& pf, DWORD caps,
 			std::function<void(const DDSURFACEDESC2&)> initFunc);
@@ -78,6 +91,11 @@ namespace D3dDdi
 		std::map<DDPIXELFORMAT, Surface> m_textures;
 		std::vector<Surface> m_releasedSurfaces;
 		Surface m_sysMemSurface;
+		std::vector<PooledSurface> m_surfacePool;
+		UINT64 m_surfacePoolTick;
+		UINT m_surfacePoolHits;
+		UINT m_surfacePoolMisses;
+		UINT m_surfacePoolEvictions;
 		
 		static bool s_inCreateSurface;
 	};
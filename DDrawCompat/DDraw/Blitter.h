@@ -10,5 +10,8 @@ namespace DDraw
 			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
 			DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey);
 		void colorFill(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD bytesPerPixel, DWORD color);
+		void endFrame();
+		void expandPalette(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch,
+			DWORD width, DWORD height, DWORD dstBytesPerPixel, const RGBQUAD* palette);
 	}
 }
@@ -0,0 +1,999 @@
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#pragma warning(disable : 4127)
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+#include <DDraw/BlitterKernels.h>
+
+namespace
+{
+	bool isAvx2Supported();
+
+	const bool g_isAvx2Supported = isAvx2Supported();
+	bool g_useAvx2 = g_isAvx2Supported;
+
+#pragma pack(1)
+	class UInt24
+	{
+	public:
+		UInt24(DWORD value)
+		{
+			m_low16 = static_cast<WORD>(value);
+			m_high8 = static_cast<BYTE>((value & 0x00FF0000) >> 16);
+		}
+
+	private:
+		WORD m_low16;
+		BYTE m_high8;
+	};
+#pragma pack()
+
+	template <int vectorSize>
+	struct Vector
+	{
+		typedef __m128i type;
+	};
+
+	template <>
+	struct Vector<32>
+	{
+		typedef __m256i type;
+	};
+
+	template <typename Elem, std::size_t... dim>
+	struct MultiDimArray;
+
+	template <typename Elem, std::size_t firstDim, std::size_t... dim>
+	struct MultiDimArray<Elem, firstDim, dim...>
+	{
+		typedef std::array<typename MultiDimArray<Elem, dim...>::type, firstDim> type;
+	};
+
+	template <typename Elem, std::size_t dim>
+	struct MultiDimArray<Elem, dim>
+	{
+		typedef std::array<Elem, dim> type;
+	};
+
+	template <int n> __m128i _mm_cmpeq_epi(__m128i a, __m128i b);
+	template <> __m128i _mm_cmpeq_epi<8>(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+	template <> __m128i _mm_cmpeq_epi<16>(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+	template <> __m128i _mm_cmpeq_epi<32>(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+
+	template <int n> __m256i _mm256_cmpeq_epi(__m256i a, __m256i b);
+	template <> __m256i _mm256_cmpeq_epi<8>(__m256i a, __m256i b) { return _mm256_cmpeq_epi8(a, b); }
+	template <> __m256i _mm256_cmpeq_epi<16>(__m256i a, __m256i b) { return _mm256_cmpeq_epi16(a, b); }
+	template <> __m256i _mm256_cmpeq_epi<32>(__m256i a, __m256i b) { return _mm256_cmpeq_epi32(a, b); }
+
+	template <int n> typename Vector<n / 8>::type _mm_loadu_si(const void* p);
+	template <> __m128i _mm_loadu_si<8>(const void* p) { return _mm_cvtsi32_si128(*static_cast<const uint8_t*>(p)); }
+	template <> __m128i _mm_loadu_si<16>(const void* p) { return _mm_cvtsi32_si128(*static_cast<const uint16_t*>(p)); }
+	template <> __m128i _mm_loadu_si<32>(const void* p) { return _mm_cvtsi32_si128(*static_cast<const uint32_t*>(p)); }
+	template <> __m128i _mm_loadu_si<64>(const void* p) { return _mm_loadl_epi64(static_cast<const __m128i*>(p)); }
+	template <> __m128i _mm_loadu_si<128>(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+	template <> __m256i _mm_loadu_si<256>(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+
+	template <int n> __m128i _mm_set1_epi(DWORD a);
+	template <> __m128i _mm_set1_epi<8>(DWORD a) { return _mm_set1_epi8(static_cast<uint8_t>(a)); }
+	template <> __m128i _mm_set1_epi<16>(DWORD a) { return _mm_set1_epi16(static_cast<uint16_t>(a)); }
+	template <> __m128i _mm_set1_epi<32>(DWORD a) { return _mm_set1_epi32(a); }
+
+	template <int n> __m256i _mm256_set1_epi(DWORD a);
+	template <> __m256i _mm256_set1_epi<8>(DWORD a) { return _mm256_set1_epi8(static_cast<uint8_t>(a)); }
+	template <> __m256i _mm256_set1_epi<16>(DWORD a) { return _mm256_set1_epi16(static_cast<uint16_t>(a)); }
+	template <> __m256i _mm256_set1_epi<32>(DWORD a) { return _mm256_set1_epi32(a); }
+
+	template <int n> void _mm_storeu_si(void* p, typename Vector<n / 8>::type a);
+	template <> void _mm_storeu_si<8>(void* p, __m128i a) { *static_cast<uint8_t*>(p) = static_cast<uint8_t>(_mm_cvtsi128_si32(a)); }
+	template <> void _mm_storeu_si<16>(void* p, __m128i a) { *static_cast<uint16_t*>(p) = static_cast<uint16_t>(_mm_cvtsi128_si32(a)); }
+	template <> void _mm_storeu_si<32>(void* p, __m128i a) { *static_cast<uint32_t*>(p) = _mm_cvtsi128_si32(a); }
+	template <> void _mm_storeu_si<64>(void* p, __m128i a) { _mm_storel_epi64(static_cast<__m128i*>(p), a); }
+	template <> void _mm_storeu_si<128>(void* p, __m128i a) { _mm_storeu_si128(static_cast<__m128i*>(p), a); }
+	template <> void _mm_storeu_si<256>(void* p, __m256i a) { _mm256_storeu_si256(static_cast<__m256i*>(p), a); }
+
+	__forceinline __m128i _mm_and_si(__m128i a, __m128i b) { return _mm_and_si128(a, b); }
+	__forceinline __m256i _mm_and_si(__m256i a, __m256i b) { return _mm256_and_si256(a, b); }
+	__forceinline __m128i _mm_andnot_si(__m128i a, __m128i b) { return _mm_andnot_si128(a, b); }
+	__forceinline __m256i _mm_andnot_si(__m256i a, __m256i b) { return _mm256_andnot_si256(a, b); }
+	__forceinline __m128i _mm_or_si(__m128i a, __m128i b) { return _mm_or_si128(a, b); }
+	__forceinline __m256i _mm_or_si(__m256i a, __m256i b) { return _mm256_or_si256(a, b); }
+
+	void cpuid(int cpuInfo[4], int leaf)
+	{
+#ifdef _MSC_VER
+		__cpuidex(cpuInfo, leaf, 0);
+#else
+		__cpuid_count(leaf, 0, cpuInfo[0], cpuInfo[1], cpuInfo[2], cpuInfo[3]);
+#endif
+	}
+
+	unsigned long long xgetbv()
+	{
+#ifdef _MSC_VER
+		return _xgetbv(0);
+#else
+		unsigned eax = 0;
+		unsigned edx = 0;
+		__asm__ volatile("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+		return (static_cast<unsigned long long>(edx) << 32) | eax;
+#endif
+	}
+
+	bool isAvx2Supported()
+	{
+		int cpuInfo[4] = {};
+		cpuid(cpuInfo, 0);
+		if (cpuInfo[0] < 7)
+		{
+			return false;
+		}
+
+		const int osXsaveAndAvx = (1 << 27) | (1 << 28);
+		cpuid(cpuInfo, 1);
+		if ((cpuInfo[2] & osXsaveAndAvx) != osXsaveAndAvx ||
+			(xgetbv() & 6) != 6)
+		{
+			return false;
+		}
+
+		cpuid(cpuInfo, 7);
+		return 0 != (cpuInfo[1] & (1 << 5));
+	}
+
+	template <typename Pixel, int vectorSize>
+	__forceinline __m128i reverseVector(__m128i vec)
+	{
+		if (16 == vectorSize)
+		{
+			vec = _mm_shuffle_epi32(vec, _MM_SHUFFLE(0, 1, 2, 3));
+		}
+		else if (8 == vectorSize)
+		{
+			vec = _mm_shuffle_epi32(vec, _MM_SHUFFLE(3, 2, 0, 1));
+		}
+
+		if (sizeof(Pixel) <= 2)
+		{
+			if (vectorSize > 2)
+			{
+				vec = _mm_shufflelo_epi16(vec, _MM_SHUFFLE(2, 3, 0, 1));
+			}
+			if (16 == vectorSize)
+			{
+				vec = _mm_shufflehi_epi16(vec, _MM_SHUFFLE(2, 3, 0, 1));
+			}
+		}
+
+		if (1 == sizeof(Pixel) && vectorSize > 1)
+		{
+			vec = _mm_or_si128(_mm_slli_epi16(vec, 8), _mm_srli_epi16(vec, 8));
+		}
+
+		return vec;
+	}
+
+	template <typename Pixel>
+	__forceinline __m256i reverseVector256(__m256i vec)
+	{
+		const __m128i mask = 4 == sizeof(Pixel)
+			? _mm_setr_epi8(12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3)
+			: 2 == sizeof(Pixel)
+			? _mm_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1)
+			: _mm_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0);
+		vec = _mm256_shuffle_epi8(vec, _mm256_broadcastsi128_si256(mask));
+		return _mm256_permute4x64_epi64(vec, _MM_SHUFFLE(1, 0, 3, 2));
+	}
+
+	template <int pixelsPerVector>
+	__forceinline void loadSrcVectorRemainder(__m128i& vec1, __m128i& vec2,
+		const BYTE*& src, const int*& column, std::integral_constant<int, 1> /*count*/)
+	{
+		vec1 = _mm_insert_epi16(vec1, *(src + *column), (pixelsPerVector - 1) / 2);
+		++column;
+	}
+
+	template <int pixelsPerVector>
+	__forceinline void loadSrcVectorRemainder(__m128i& /*vec1*/, __m128i& /*vec2*/,
+		const BYTE*& /*src*/, const int*& /*column*/, std::integral_constant<int, 0> /*count*/)
+	{
+	}
+
+	template <int pixelsPerVector>
+	__forceinline void loadSrcVectorRemainder(__m128i& /*vec1*/, __m128i& /*vec2*/,
+		const BYTE*& /*src*/, const int*& /*column*/, std::integral_constant<int, -1> /*count*/)
+	{
+	}
+
+	template <int pixelsPerVector, int count>
+	__forceinline void loadSrcVectorRemainder(__m128i& vec1, __m128i& vec2,
+		const BYTE*& src, const int*& column, std::integral_constant<int, count>)
+	{
+		vec1 = _mm_insert_epi16(vec1, *(src + *column), (pixelsPerVector - count) / 2);
+		++column;
+		vec2 = _mm_insert_epi16(vec2, *(src + *column), (pixelsPerVector - count) / 2);
+		++column;
+		loadSrcVectorRemainder<pixelsPerVector>(vec1, vec2, src, column, std::integral_constant<int, count - 2>());
+	}
+
+	template <int pixelsPerVector>
+	__forceinline void loadSrcVectorRemainder(__m128i& /*vec*/,
+		const BYTE* /*src*/, const int*& /*column*/, std::integral_constant<int, 0> /*count*/)
+	{
+	}
+
+	template <int pixelsPerVector, int count>
+	__forceinline typename std::enable_if<0 != count>::type loadSrcVectorRemainder(__m128i& vec,
+		const BYTE* src, const int*& column, std::integral_constant<int, count>)
+	{
+		__m128i vec2 = _mm_loadu_si<8>(src + *column);
+		++column;
+		loadSrcVectorRemainder<pixelsPerVector>(vec, vec2, src, column, std::integral_constant<int, count - 1>());
+		vec2 = _mm_slli_si128(vec2, 1);
+		vec = _mm_or_si128(vec, vec2);
+	}
+
+	template <int pixelsPerVector>
+	__forceinline void loadSrcVectorRemainder(__m128i& /*vec*/,
+		const WORD* /*src*/, const int*& /*column*/, std::integral_constant<int, 0> /*count*/)
+	{
+	}
+
+	template <int pixelsPerVector, int count>
+	__forceinline typename std::enable_if<0 != count>::type loadSrcVectorRemainder(__m128i& vec,
+		const WORD* src, const int*& column, std::integral_constant<int, count>)
+	{
+		vec = _mm_insert_epi16(vec, *(src + *column), pixelsPerVector - count);
+		++column;
+		loadSrcVectorRemainder<pixelsPerVector>(vec, src, column, std::integral_constant<int, count - 1>());
+	}
+
+	template <int pixelsPerVector>
+	__forceinline void loadSrcVectorRemainder(__m128i& /*vec*/,
+		const DWORD* /*src*/, const int*& /*column*/, std::integral_constant<int, 0> /*count*/)
+	{
+	}
+
+	template <int pixelsPerVector, int count>
+	__forceinline typename std::enable_if<0 != count>::type loadSrcVectorRemainder(__m128i& vec,
+		const DWORD* src, const int*& column, std::integral_constant<int, count>)
+	{
+		__m128i pixel = _mm_loadu_si32(src + *column);
+		pixel = _mm_slli_si128(pixel, (pixelsPerVector - count) * 4);
+		vec = _mm_or_si128(vec, pixel);
+		++column;
+		loadSrcVectorRemainder<pixelsPerVector>(vec, src, column, std::integral_constant<int, count - 1>());
+	}
+
+	template <int vectorSize, bool stretch, bool mirror, typename Pixel>
+	__forceinline std::enable_if_t<32 != vectorSize, __m128i> loadSrcVector(const Pixel*& src, const int*& column)
+	{
+		const int pixelsPerVector = vectorSize / sizeof(Pixel);
+		__m128i vec = _mm_loadu_si<sizeof(Pixel) * 8>(stretch ? src + *column : src);
+		if (stretch)
+		{
+			++column;
+			loadSrcVectorRemainder<pixelsPerVector>(vec, src, column,
+				std::integral_constant<int, pixelsPerVector - 1>());
+		}
+		else
+		{
+			vec = _mm_loadu_si<vectorSize * 8>(src);
+			if (mirror)
+			{
+				vec = reverseVector<Pixel, vectorSize>(vec);
+				src -= pixelsPerVector;
+			}
+			else
+			{
+				src += pixelsPerVector;
+			}
+		}
+		return vec;
+	}
+
+	template <int vectorSize, bool stretch, bool mirror, typename Pixel>
+	__forceinline std::enable_if_t<32 == vectorSize, __m256i> loadSrcVector(const Pixel*& src, const int*& column)
+	{
+		const int pixelsPerVector = 32 / sizeof(Pixel);
+		if (stretch)
+		{
+			if (4 == sizeof(Pixel))
+			{
+				__m256i vec = _mm256_i32gather_epi32(reinterpret_cast<const int*>(src), _mm_loadu_si<256>(column), 4);
+				column += pixelsPerVector;
+				return vec;
+			}
+
+			__m128i low = loadSrcVector<16, true, false>(src, column);
+			__m128i high = loadSrcVector<16, true, false>(src, column);
+			return _mm256_set_m128i(high, low);
+		}
+
+		__m256i vec = _mm_loadu_si<256>(src);
+		if (mirror)
+		{
+			vec = reverseVector256<Pixel>(vec);
+			src -= pixelsPerVector;
+		}
+		else
+		{
+			src += pixelsPerVector;
+		}
+		return vec;
+	}
+
+	template <typename Pixel>
+	__forceinline __m128i compareColorKey(__m128i vec, DWORD colorKey)
+	{
+		__m128i colorKeyVec = _mm_set1_epi<sizeof(Pixel) * 8>(colorKey);
+		if (4 == sizeof(Pixel))
+		{
+			__m128i colorKeyMask = _mm_set1_epi<sizeof(Pixel) * 8>(0x00FFFFFF);
+			vec = _mm_and_si128(vec, colorKeyMask);
+		}
+		return _mm_cmpeq_epi<sizeof(Pixel) * 8>(vec, colorKeyVec);
+	}
+
+	template <typename Pixel>
+	__forceinline __m256i compareColorKey(__m256i vec, DWORD colorKey)
+	{
+		__m256i colorKeyVec = _mm256_set1_epi<sizeof(Pixel) * 8>(colorKey);
+		if (4 == sizeof(Pixel))
+		{
+			__m256i colorKeyMask = _mm256_set1_epi<sizeof(Pixel) * 8>(0x00FFFFFF);
+			vec = _mm256_and_si256(vec, colorKeyMask);
+		}
+		return _mm256_cmpeq_epi<sizeof(Pixel) * 8>(vec, colorKeyVec);
+	}
+
+	template <typename Pixel, bool mirror, bool useDstColorKey, bool useSrcColorKey, typename Vec>
+	__forceinline Vec bltVector(Vec dst, Vec src, DWORD dstColorKey, DWORD srcColorKey)
+	{
+		if (useDstColorKey && useSrcColorKey)
+		{
+			Vec maskDst = compareColorKey<Pixel>(dst, dstColorKey);
+			Vec maskSrc = compareColorKey<Pixel>(src, srcColorKey);
+			Vec mask = _mm_andnot_si(maskSrc, maskDst);
+			dst = _mm_andnot_si(mask, dst);
+			src = _mm_and_si(mask, src);
+			return _mm_or_si(dst, src);
+		}
+		else if (useDstColorKey)
+		{
+			Vec mask = compareColorKey<Pixel>(dst, dstColorKey);
+			dst = _mm_andnot_si(mask, dst);
+			src = _mm_and_si(mask, src);
+			return _mm_or_si(dst, src);
+		}
+		else if (useSrcColorKey)
+		{
+			Vec mask = compareColorKey<Pixel>(src, srcColorKey);
+			dst = _mm_and_si(mask, dst);
+			src = _mm_andnot_si(mask, src);
+			return _mm_or_si(dst, src);
+		}
+		else
+		{
+			return src;
+		}
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	__forceinline void bltVector(Pixel*& dst, const Pixel*& src, const int*& column,
+		DWORD dstColorKey, DWORD srcColorKey)
+	{
+		auto s = loadSrcVector<vectorSize, stretch, mirror>(src, column);
+		auto d = _mm_loadu_si<vectorSize * 8>(dst);
+		d = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey>(d, s, dstColorKey, srcColorKey);
+		_mm_storeu_si<vectorSize * 8>(dst, d);
+		dst += vectorSize / sizeof(Pixel);
+	}
+
+	template <int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey, typename Pixel>
+	__forceinline void bltVectorRow(Pixel* dst, const Pixel* src, DWORD width, const int* column,
+		DWORD dstColorKey, DWORD srcColorKey)
+	{
+		const int pixelsPerVector = vectorSize / sizeof(Pixel);
+
+		if (vectorSize >= 16)
+		{
+			for (DWORD i = width / pixelsPerVector - 1; i != 0; --i)
+			{
+				bltVector<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>(
+					dst, src, column, dstColorKey, srcColorKey);
+			}
+		}
+
+		if (sizeof(Pixel) < vectorSize)
+		{
+			const DWORD remainder = width % pixelsPerVector;
+			auto src1 = src;
+			auto column1 = column;
+			auto s1 = loadSrcVector<vectorSize, stretch, mirror>(src1, column1);
+			if (stretch)
+			{
+				column += remainder;
+			}
+			else if (mirror)
+			{
+				src -= remainder;
+			}
+			else
+			{
+				src += remainder;
+			}
+			auto s2 = loadSrcVector<vectorSize, stretch, mirror>(src, column);
+			auto d1 = _mm_loadu_si<vectorSize * 8>(dst);
+			auto d2 = _mm_loadu_si<vectorSize * 8>(dst + remainder);
+			d1 = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey>(d1, s1, dstColorKey, srcColorKey);
+			_mm_storeu_si<vectorSize * 8>(dst, d1);
+			d2 = bltVector<Pixel, mirror, useDstColorKey, useSrcColorKey>(d2, s2, dstColorKey, srcColorKey);
+			_mm_storeu_si<vectorSize * 8>(dst + remainder, d2);
+		}
+		else
+		{
+			bltVector<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>(
+				dst, src, column, dstColorKey, srcColorKey);
+		}
+	}
+
+	template <bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	__forceinline void bltPixel(UInt24*& dst, const UInt24*& src, const int*& column,
+		DWORD dstColorKey, DWORD srcColorKey)
+	{
+		const UInt24* src1 = stretch ? src + *column : src;
+		if (useDstColorKey || useSrcColorKey)
+		{
+			const DWORD d = *reinterpret_cast<const WORD*>(dst) | (reinterpret_cast<const BYTE*>(dst)[2] << 16);
+			const DWORD s = *reinterpret_cast<const WORD*>(src1) | (reinterpret_cast<const BYTE*>(src1)[2] << 16);
+			const DWORD mask = static_cast<DWORD>(-static_cast<int>(
+				(!useDstColorKey || dstColorKey == d) &&
+				(!useSrcColorKey || srcColorKey != s)));
+			*dst = (d & ~mask) | (s & mask);
+		}
+		else
+		{
+			*dst = *src1;
+		}
+
+		++dst;
+		if (stretch)
+		{
+			++column;
+		}
+		else
+		{
+			src += mirror ? -1 : 1;
+		}
+	}
+
+	template <int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	__forceinline void bltVectorRow(UInt24* dst, const UInt24* src, DWORD width, const int* column,
+		DWORD dstColorKey, DWORD srcColorKey)
+	{
+		if (!stretch && !mirror && !useDstColorKey && !useSrcColorKey)
+		{
+			bltVectorRow<vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey, BYTE>(
+				reinterpret_cast<BYTE*>(dst), reinterpret_cast<const BYTE*>(src),
+				width * 3, column, dstColorKey, srcColorKey);
+			return;
+		}
+
+		if (2 == vectorSize)
+		{
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, column, dstColorKey, srcColorKey);
+			return;
+		}
+
+		if (4 == vectorSize)
+		{
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, column, dstColorKey, srcColorKey);
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, column, dstColorKey, srcColorKey);
+			return;
+		}
+
+		for (DWORD i = width; i != 0; --i)
+		{
+			bltPixel<stretch, mirror, useDstColorKey, useSrcColorKey>(dst, src, column, dstColorKey, srcColorKey);
+		}
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	__forceinline std::enable_if_t<vectorSize >= sizeof(Pixel) || (2 == vectorSize && 3 == sizeof(Pixel))> vectorizedBlt(
+		BYTE * dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const BYTE * src, DWORD srcPitch, const int* columns, int offsetY, int deltaY,
+		DWORD dstColorKey, DWORD srcColorKey)
+	{
+		if (3 != sizeof(Pixel) && !stretch && mirror)
+		{
+			src -= vectorSize - sizeof(Pixel);
+		}
+
+		for (DWORD i = dstHeight; i != 0; --i)
+		{
+			bltVectorRow<vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>(
+				reinterpret_cast<Pixel*>(dst),
+				reinterpret_cast<const Pixel*>(src + (offsetY >> 16) * static_cast<int>(srcPitch)),
+				dstWidth, columns, dstColorKey, srcColorKey);
+			dst += dstPitch;
+			offsetY += deltaY;
+		}
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	__forceinline std::enable_if_t < vectorSize < sizeof(Pixel) && (2 != vectorSize || 3 != sizeof(Pixel))> vectorizedBlt(
+		BYTE* /*dst*/, DWORD /*dstPitch*/, DWORD /*dstWidth*/, DWORD /*dstHeight*/,
+		const BYTE* /*src*/, DWORD /*srcPitch*/, const int* /*columns*/, int /*offsetY*/, int /*deltaY*/,
+		const DWORD /*dstColorKey*/, const DWORD /*srcColorKey*/)
+	{
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	void vectorizedBltFunc(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const void* src, DWORD srcPitch, const int* columns, int offsetY, int deltaY,
+		DWORD dstColorKey, DWORD srcColorKey)
+	{
+		vectorizedBlt<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>(
+			static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight,
+			static_cast<const BYTE*>(src), srcPitch, columns, offsetY, deltaY, dstColorKey, srcColorKey);
+		if (32 == vectorSize)
+		{
+			_mm256_zeroupper();
+		}
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey>
+	auto getVectorizedBltFunc()
+	{
+		return &vectorizedBltFunc<Pixel, vectorSize, stretch, mirror, useDstColorKey, useSrcColorKey>;
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror, bool useDstColorKey>
+	auto getVectorizedBltFunc(bool useSrcColorKey)
+	{
+		return useSrcColorKey
+			? getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, useDstColorKey, true>()
+			: getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, useDstColorKey, false>();
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch, bool mirror>
+	auto getVectorizedBltFunc(bool useDstColorKey, bool useSrcColorKey)
+	{
+		return useDstColorKey
+			? getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, true>(useSrcColorKey)
+			: getVectorizedBltFunc<Pixel, vectorSize, stretch, mirror, false>(useSrcColorKey);
+	}
+
+	template <typename Pixel, int vectorSize, bool stretch>
+	auto getVectorizedBltFunc(bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	{
+		return mirror
+			? getVectorizedBltFunc<Pixel, vectorSize, stretch, true>(useDstColorKey, useSrcColorKey)
+			: getVectorizedBltFunc<Pixel, vectorSize, stretch, false>(useDstColorKey, useSrcColorKey);
+	}
+
+	template <typename Pixel, int vectorSize>
+	auto getVectorizedBltFunc(bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	{
+		return stretch
+			? getVectorizedBltFunc<Pixel, vectorSize, true>(mirror, useDstColorKey, useSrcColorKey)
+			: getVectorizedBltFunc<Pixel, vectorSize, false>(mirror, useDstColorKey, useSrcColorKey);
+	}
+
+	template <typename Pixel>
+	auto getVectorizedBltFunc(DWORD width, bool avx2, bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	{
+		if (width >= 32 && avx2)
+		{
+			return getVectorizedBltFunc<Pixel, 32>(stretch, mirror, useDstColorKey, useSrcColorKey);
+		}
+		if (width >= 16) return getVectorizedBltFunc<Pixel, 16>(stretch, mirror, useDstColorKey, useSrcColorKey);
+		if (width >= 8) return getVectorizedBltFunc<Pixel, 8>(stretch, mirror, useDstColorKey, useSrcColorKey);
+		if (width >= 4) return getVectorizedBltFunc<Pixel, 4>(stretch, mirror, useDstColorKey, useSrcColorKey);
+		if (width >= 2) return getVectorizedBltFunc<Pixel, 2>(stretch, mirror, useDstColorKey, useSrcColorKey);
+		return getVectorizedBltFunc<Pixel, 1>(stretch, mirror, useDstColorKey, useSrcColorKey);
+	}
+
+	auto getVectorizedBltFunc(DWORD bytesPerPixel, DWORD width, bool avx2,
+		bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	{
+		switch (bytesPerPixel)
+		{
+		case 4: return getVectorizedBltFunc<DWORD>(width, avx2, stretch, mirror, useDstColorKey, useSrcColorKey);
+		case 3: return getVectorizedBltFunc<UInt24>(width, avx2, stretch, mirror, useDstColorKey, useSrcColorKey);
+		case 2: return getVectorizedBltFunc<WORD>(width, avx2, stretch, mirror, useDstColorKey, useSrcColorKey);
+		default: return getVectorizedBltFunc<BYTE>(width, avx2, stretch, mirror, useDstColorKey, useSrcColorKey);
+		}
+	}
+
+	auto getVectorizedBltFuncs()
+	{
+		typename MultiDimArray<DDraw::BlitterKernels::BltFunc, 2, 4, 6, 2, 2, 2, 2>::type vectorizedBltFuncs;
+		for (int avx2 = 0; avx2 <= 1; ++avx2)
+		{
+			for (int bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
+			{
+				for (int width = 0; width <= 5; ++width)
+				{
+					for (int stretch = 0; stretch <= 1; ++stretch)
+					{
+						for (int mirror = 0; mirror <= 1; ++mirror)
+						{
+							for (int useDstColorKey = 0; useDstColorKey <= 1; ++useDstColorKey)
+							{
+								for (int useSrcColorKey = 0; useSrcColorKey <= 1; ++useSrcColorKey)
+								{
+									vectorizedBltFuncs[avx2][bytesPerPixel - 1][width][stretch][mirror][useDstColorKey][useSrcColorKey] =
+										getVectorizedBltFunc(bytesPerPixel, 1U << width, avx2,
+											stretch, mirror, useDstColorKey, useSrcColorKey);
+								}
+							}
+						}
+					}
+				}
+			}
+		}
+		return vectorizedBltFuncs;
+	}
+
+	const auto g_vectorizedBltFuncs(getVectorizedBltFuncs());
+
+	struct ByteRect
+	{
+		LONG left;
+		LONG top;
+		LONG right;
+		LONG bottom;
+	};
+
+	bool operator==(const ByteRect& lhs, const ByteRect& rhs)
+	{
+		return lhs.left == rhs.left && lhs.top == rhs.top && lhs.right == rhs.right && lhs.bottom == rhs.bottom;
+	}
+
+	bool intersects(const ByteRect& lhs, const ByteRect& rhs)
+	{
+		return std::max<LONG>(lhs.left, rhs.left) < std::min<LONG>(lhs.right, rhs.right) &&
+			std::max<LONG>(lhs.top, rhs.top) < std::min<LONG>(lhs.bottom, rhs.bottom);
+	}
+
+	DDraw::BlitterKernels::BltFunc getVectorizedBltFunc(DWORD bytesPerPixel, DWORD byteWidth,
+		bool stretch, bool mirror, bool useDstColorKey, bool useSrcColorKey)
+	{
+		return g_vectorizedBltFuncs[g_useAvx2][bytesPerPixel - 1]
+			[(byteWidth >= 2) + (byteWidth >= 4) + (byteWidth >= 8) + (byteWidth >= 16) + (byteWidth >= 32)]
+			[stretch][mirror][useDstColorKey][useSrcColorKey];
+	}
+
+	void colorFillAvx2(BYTE* dst, DWORD dstPitch, DWORD dstByteWidth, DWORD dstHeight, __m256i color)
+	{
+		for (DWORD i = dstHeight; i != 0; --i)
+		{
+			BYTE* const rowEnd = dst + dstByteWidth - 32;
+			for (BYTE* p = dst; p < rowEnd; p += 32)
+			{
+				_mm_storeu_si<256>(p, color);
+			}
+			_mm_storeu_si<256>(rowEnd, color);
+			dst += dstPitch;
+		}
+		_mm256_zeroupper();
+	}
+
+	template <typename Pixel>
+	void colorFill(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD color)
+	{
+		DWORD c = 0;
+		memset(&c, color, sizeof(Pixel));
+		if (c == color)
+		{
+			for (DWORD i = dstHeight; i != 0; --i)
+			{
+				memset(dst, color, dstWidth * sizeof(Pixel));
+				dst += dstPitch;
+			}
+			return;
+		}
+
+		if ((2 == sizeof(Pixel) || 4 == sizeof(Pixel)) && dstWidth * sizeof(Pixel) >= 32 && g_useAvx2)
+		{
+			colorFillAvx2(dst, dstPitch, dstWidth * sizeof(Pixel), dstHeight,
+				_mm256_set1_epi<(2 == sizeof(Pixel) ? 16 : 32)>(color));
+			return;
+		}
+
+		for (DWORD i = 0; i < dstWidth; ++i)
+		{
+			reinterpret_cast<Pixel*>(dst)[i] = static_cast<Pixel>(color);
+		}
+
+		for (DWORD i = dstHeight - 1; i != 0; --i)
+		{
+			memcpy(dst + dstPitch, dst, dstWidth * sizeof(Pixel));
+			dst += dstPitch;
+		}
+	}
+
+	template <typename Pixel>
+	void expandPaletteAvx2(BYTE* dst, DWORD dstPitch, const BYTE* src, DWORD srcPitch,
+		DWORD width, DWORD height, const DWORD* lut)
+	{
+		const DWORD vectorWidth = width & ~7;
+		for (DWORD i = height; i != 0; --i)
+		{
+			for (DWORD x = 0; x < vectorWidth; x += 8)
+			{
+				const __m256i indexes = _mm256_cvtepu8_epi32(_mm_loadu_si<64>(src + x));
+				const __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut), indexes, 4);
+				if constexpr (4 == sizeof(Pixel))
+				{
+					_mm_storeu_si<256>(dst + x * 4, colors);
+				}
+				else
+				{
+					const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi32(colors, colors), 0x08);
+					_mm_storeu_si<128>(dst + x * 2, _mm256_castsi256_si128(packed));
+				}
+			}
+
+			for (DWORD x = vectorWidth; x < width; ++x)
+			{
+				reinterpret_cast<Pixel*>(dst)[x] = static_cast<Pixel>(lut[src[x]]);
+			}
+
+			src += srcPitch;
+			dst += dstPitch;
+		}
+		_mm256_zeroupper();
+	}
+
+	template <typename Pixel>
+	void expandPalette(BYTE* dst, DWORD dstPitch, const BYTE* src, DWORD srcPitch,
+		DWORD width, DWORD height, const RGBQUAD* palette)
+	{
+		DWORD lut[256] = {};
+		for (UINT i = 0; i < 256; ++i)
+		{
+			if (4 == sizeof(Pixel))
+			{
+				memcpy(&lut[i], &palette[i], sizeof(lut[i]));
+			}
+			else
+			{
+				lut[i] = ((palette[i].rgbRed & 0xF8) << 8) | ((palette[i].rgbGreen & 0xFC) << 3) | (palette[i].rgbBlue >> 3);
+			}
+		}
+
+		if (width >= 8 && g_useAvx2)
+		{
+			expandPaletteAvx2<Pixel>(dst, dstPitch, src, srcPitch, width, height, lut);
+			return;
+		}
+
+		for (DWORD i = height; i != 0; --i)
+		{
+			Pixel* d = reinterpret_cast<Pixel*>(dst);
+			for (DWORD x = 0; x < width; ++x)
+			{
+				d[x] = static_cast<Pixel>(lut[src[x]]);
+			}
+			src += srcPitch;
+			dst += dstPitch;
+		}
+	}
+}
+
+namespace DDraw
+{
+	namespace BlitterKernels
+	{
+		void colorFill(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD bytesPerPixel, DWORD color)
+		{
+			switch (bytesPerPixel)
+			{
+			case 1: return ::colorFill<BYTE>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
+			case 2: return ::colorFill<WORD>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
+			case 3: return ::colorFill<UInt24>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
+			case 4: return ::colorFill<DWORD>(static_cast<BYTE*>(dst), dstPitch, dstWidth, dstHeight, color);
+			}
+		}
+
+		void enableAvx2(bool enable)
+		{
+			g_useAvx2 = enable && g_isAvx2Supported;
+		}
+
+		void executeBlt(const BltArgs& args)
+		{
+			args.func(args.dst, args.dstPitch, args.dstWidth, args.dstHeight,
+				args.src, args.srcPitch, args.columns, args.offsetY, args.deltaY,
+				args.dstColorKey, args.srcColorKey);
+		}
+
+		void expandPalette(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch,
+			DWORD width, DWORD height, DWORD dstBytesPerPixel, const RGBQUAD* palette)
+		{
+			switch (dstBytesPerPixel)
+			{
+			case 2: return ::expandPalette<WORD>(static_cast<BYTE*>(dst), dstPitch,
+				static_cast<const BYTE*>(src), srcPitch, width, height, palette);
+			case 4: return ::expandPalette<DWORD>(static_cast<BYTE*>(dst), dstPitch,
+				static_cast<const BYTE*>(src), srcPitch, width, height, palette);
+			}
+		}
+
+		void fillStretchColumns(std::vector<int>& columns, const StretchParams& stretch)
+		{
+			// The narrowest vectorized loads read one column past the end of the row
+			columns.resize(stretch.dstWidth + 1);
+			int offset = stretch.offset;
+			for (auto& column : columns)
+			{
+				column = offset >> 16;
+				offset += stretch.delta;
+			}
+		}
+
+		BltArgs getBltArgs(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey, StretchParams& stretch)
+		{
+			const bool mirrorLeftRight = srcWidth < 0;
+			const bool mirrorUpDown = srcHeight < 0;
+			const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
+			const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+
+			int deltaX = (absSrcWidth << 16) / dstWidth;
+			int deltaY = (absSrcHeight << 16) / dstHeight;
+
+			int offsetX = deltaX / 2;
+			int offsetY = deltaY / 2;
+
+			if (mirrorLeftRight)
+			{
+				offsetX += static_cast<int>(dstWidth - 1) * deltaX;
+				deltaX = -deltaX;
+			}
+			if (mirrorUpDown)
+			{
+				offsetY += static_cast<int>(dstHeight - 1) * deltaY;
+				deltaY = -deltaY;
+			}
+
+			auto srcStart = static_cast<const BYTE*>(src) +
+				(offsetY >> 16) * static_cast<int>(srcPitch) + (offsetX >> 16) * static_cast<int>(bytesPerPixel);
+			offsetX &= 0x0000FFFF;
+			offsetY &= 0x0000FFFF;
+
+			stretch = { absSrcWidth, dstWidth, mirrorLeftRight, offsetX, deltaX };
+
+			BltArgs args = {};
+			args.func = getVectorizedBltFunc(bytesPerPixel, dstWidth * bytesPerPixel,
+				dstWidth != absSrcWidth, mirrorLeftRight, nullptr != dstColorKey, nullptr != srcColorKey);
+			args.dst = dst;
+			args.dstPitch = dstPitch;
+			args.dstWidth = dstWidth;
+			args.dstHeight = dstHeight;
+			args.src = srcStart;
+			args.srcPitch = srcPitch;
+			args.offsetY = offsetY;
+			args.deltaY = deltaY;
+			args.dstColorKey = dstColorKey ? *dstColorKey & 0x00FFFFFF : 0;
+			args.srcColorKey = srcColorKey ? *srcColorKey & 0x00FFFFFF : 0;
+			return args;
+		}
+
+		bool isAvx2Enabled()
+		{
+			return g_useAvx2;
+		}
+
+		Overlap stageOverlappingSrc(void* dstPtr, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void*& srcPtr, DWORD& srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, bool useColorKey, std::vector<BYTE>& buffer)
+		{
+			if (dstPitch != srcPitch)
+			{
+				return Overlap::NONE;
+			}
+
+			BYTE* dst = static_cast<BYTE*>(dstPtr);
+			const BYTE* src = static_cast<const BYTE*>(srcPtr);
+			const DWORD pitch = dstPitch;
+
+			const bool mirrorLeftRight = srcWidth < 0;
+			const bool mirrorUpDown = srcHeight < 0;
+			const DWORD absSrcWidth = mirrorLeftRight ? -srcWidth : srcWidth;
+			const DWORD absSrcHeight = mirrorUpDown ? -srcHeight : srcHeight;
+
+			const BYTE* dstEnd = dst + (dstHeight - 1) * pitch + dstWidth * bytesPerPixel;
+			const BYTE* srcEnd = src + (absSrcHeight - 1) * pitch + absSrcWidth * bytesPerPixel;
+			if (dst < src ? dstEnd <= src : srcEnd <= dst)
+			{
+				return Overlap::NONE;
+			}
+
+			ByteRect dstRect = { 0, 0, static_cast<LONG>(dstWidth * bytesPerPixel), static_cast<LONG>(dstHeight) };
+			ByteRect srcRect = { 0, 0, static_cast<LONG>(absSrcWidth * bytesPerPixel), static_cast<LONG>(absSrcHeight) };
+
+			srcRect.top = static_cast<LONG>((src - dst) / static_cast<LONG>(pitch));
+			srcRect.left = static_cast<LONG>((src - dst) % static_cast<LONG>(pitch));
+			srcRect.bottom += srcRect.top;
+			srcRect.right += srcRect.left;
+
+			LONG rowError = 0;
+			if (src < dst)
+			{
+				rowError = (dstRect.right - srcRect.left > static_cast<LONG>(pitch)) ? 1 : 0;
+			}
+			else
+			{
+				rowError = (srcRect.right - dstRect.left > static_cast<LONG>(pitch)) ? -1 : 0;
+			}
+			srcRect.left += rowError * pitch;
+			srcRect.right += rowError * pitch;
+			srcRect.top -= rowError;
+			srcRect.bottom -= rowError;
+
+			if (!intersects(dstRect, srcRect))
+			{
+				return Overlap::NONE;
+			}
+
+			if (!mirrorLeftRight && !mirrorUpDown)
+			{
+				if (dstRect == srcRect)
+				{
+					return Overlap::DONE;
+				}
+
+				if (dstWidth == absSrcWidth && dstHeight == absSrcHeight && !useColorKey)
+				{
+					if (dst < src)
+					{
+						for (DWORD y = dstHeight; y != 0; --y)
+						{
+							std::memmove(dst, src, dstWidth * bytesPerPixel);
+							dst += pitch;
+							src += pitch;
+						}
+					}
+					else
+					{
+						dst += (dstHeight - 1) * pitch;
+						src += (dstHeight - 1) * pitch;
+						for (DWORD y = dstHeight; y != 0; --y)
+						{
+							std::memmove(dst, src, dstWidth * bytesPerPixel);
+							dst -= pitch;
+							src -= pitch;
+						}
+					}
+					return Overlap::DONE;
+				}
+			}
+
+			const DWORD srcByteWidth = absSrcWidth * bytesPerPixel;
+			if (buffer.size() < absSrcHeight * srcByteWidth)
+			{
+				buffer.resize(absSrcHeight * srcByteWidth);
+			}
+
+			getVectorizedBltFunc(1, srcByteWidth, false, false, false, false)(buffer.data(), srcByteWidth,
+				srcByteWidth, absSrcHeight, src, pitch, nullptr, 0x8000, 0x10000, 0, 0);
+
+			srcPtr = buffer.data();
+			srcPitch = srcByteWidth;
+			return Overlap::STAGED;
+		}
+	}
+}
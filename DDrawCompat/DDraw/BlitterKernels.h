@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+
+#include <Common/Portability.h>
+
+namespace DDraw
+{
+	namespace BlitterKernels
+	{
+		typedef void (*BltFunc)(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, const int* columns, int offsetY, int deltaY,
+			DWORD dstColorKey, DWORD srcColorKey);
+
+		struct BltArgs
+		{
+			BltFunc func;
+			void* dst;
+			DWORD dstPitch;
+			DWORD dstWidth;
+			DWORD dstHeight;
+			const void* src;
+			DWORD srcPitch;
+			const int* columns;
+			int offsetY;
+			int deltaY;
+			DWORD dstColorKey;
+			DWORD srcColorKey;
+		};
+
+		struct StretchParams
+		{
+			DWORD srcWidth;
+			DWORD dstWidth;
+			bool mirror;
+			int offset;
+			int delta;
+		};
+
+		enum class Overlap
+		{
+			NONE,
+			DONE,
+			STAGED
+		};
+
+		void colorFill(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight, DWORD bytesPerPixel, DWORD color);
+		void enableAvx2(bool enable);
+		void executeBlt(const BltArgs& args);
+		void expandPalette(void* dst, DWORD dstPitch, const void* src, DWORD srcPitch,
+			DWORD width, DWORD height, DWORD dstBytesPerPixel, const RGBQUAD* palette);
+		void fillStretchColumns(std::vector<int>& columns, const StretchParams& stretch);
+		BltArgs getBltArgs(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey, StretchParams& stretch);
+		bool isAvx2Enabled();
+		Overlap stageOverlappingSrc(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+			const void*& src, DWORD& srcPitch, LONG srcWidth, LONG srcHeight,
+			DWORD bytesPerPixel, bool useColorKey, std::vector<BYTE>& buffer);
+	}
+}
@@ -58,7 +58,7 @@ namespace
 				}
 			}
 
-			if (Config::palettizedTextures.get() &&
+			if (Config::Settings::PalettizedTextures::OFF != Config::palettizedTextures.get() &&
 				(desc.ddsCaps.dwCaps & DDSCAPS_TEXTURE) &&
 				!(desc.ddsCaps.dwCaps & DDSCAPS_SYSTEMMEMORY) &&
 				(desc.dwFlags & DDSD_PIXELFORMAT) &&
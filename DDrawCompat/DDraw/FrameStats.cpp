@@ -0,0 +1,233 @@
+#include <algorithm>
+#include <array>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+#include <Common/Log.h>
+#include <Common/Path.h>
+#include <Common/ScopedCriticalSection.h>
+#include <Common/Time.h>
+#include <Config/Config.h>
+#include <DDraw/FrameStats.h>
+
+namespace
+{
+	const std::size_t MAX_FRAMES = 1024;
+	const std::size_t SUMMARY_FRAMES = 120;
+
+	struct Frame
+	{
+		long long qpcFlip;
+		long long qpcWakeup;
+		long long qpcBltStart;
+		long long qpcBltEnd;
+		long long qpcPresent;
+		UINT vsyncCount;
+	};
+
+	Compat::CriticalSection g_cs;
+	std::array<Frame, MAX_FRAMES> g_frames = {};
+	std::size_t g_frameCount = 0;
+	std::size_t g_dumpedFrameCount = 0;
+	Frame g_currentFrame = {};
+
+	double toMs(long long qpc)
+	{
+		return qpc * 1000.0 / Time::g_qpcFrequency;
+	}
+
+	const Frame& getFrame(std::size_t index)
+	{
+		return g_frames[index % MAX_FRAMES];
+	}
+
+	std::filesystem::path getDumpPath()
+	{
+		auto path(Compat::getModulePath(nullptr));
+		if (Compat::isEqual(path.extension(), ".exe"))
+		{
+			path.replace_extension();
+		}
+		path.replace_filename(L"DDrawCompatFrames-" + path.filename().native() + L".csv");
+		return path;
+	}
+
+	void writeTime(std::ostream& os, long long qpc, long long qpcBase)
+	{
+		os << ',';
+		if (0 != qpc)
+		{
+			os << toMs(qpc - qpcBase);
+		}
+	}
+}
+
+namespace DDraw
+{
+	namespace FrameStats
+	{
+		void dump()
+		{
+			if (Config::Settings::FrameStats::CSV != Config::frameStats.get())
+			{
+				return;
+			}
+
+			std::vector<Frame> frames;
+			std::size_t first = 0;
+			{
+				Compat::ScopedCriticalSection lock(g_cs);
+				if (g_dumpedFrameCount == g_frameCount)
+				{
+					return;
+				}
+
+				first = g_frameCount > MAX_FRAMES ? g_frameCount - MAX_FRAMES : 0;
+				for (std::size_t i = first; i < g_frameCount; ++i)
+				{
+					frames.push_back(getFrame(i));
+				}
+				g_dumpedFrameCount = g_frameCount;
+			}
+
+			auto path(getDumpPath());
+			std::ofstream f(path);
+			if (f.fail())
+			{
+				LOG_ONCE("ERROR: Failed to open frame statistics file for writing: " << path.u8string());
+				return;
+			}
+
+			const long long qpcBase = frames.front().qpcPresent;
+			f << "frame,flip,wakeup,blt_start,blt_end,present,vsync" << std::endl;
+			f << std::fixed << std::setprecision(3);
+			for (std::size_t i = 0; i < frames.size(); ++i)
+			{
+				const auto& frame = frames[i];
+				f << first + i;
+				writeTime(f, frame.qpcFlip, qpcBase);
+				writeTime(f, frame.qpcWakeup, qpcBase);
+				writeTime(f, frame.qpcBltStart, qpcBase);
+				writeTime(f, frame.qpcBltEnd, qpcBase);
+				writeTime(f, frame.qpcPresent, qpcBase);
+				f << ',' << frame.vsyncCount << std::endl;
+			}
+
+			LOG_INFO << "Frame statistics written to " << path.u8string();
+		}
+
+		void dumpIfFull()
+		{
+			if (Config::Settings::FrameStats::CSV != Config::frameStats.get())
+			{
+				return;
+			}
+
+			{
+				Compat::ScopedCriticalSection lock(g_cs);
+				if (g_frameCount - g_dumpedFrameCount < MAX_FRAMES)
+				{
+					return;
+				}
+			}
+			dump();
+		}
+
+		std::string getSummary()
+		{
+			Compat::ScopedCriticalSection lock(g_cs);
+			const std::size_t count = std::min<std::size_t>(g_frameCount, SUMMARY_FRAMES);
+			if (0 == count)
+			{
+				return "No frames presented";
+			}
+
+			long long latencySum = 0;
+			long long latencyMax = 0;
+			std::size_t latencyCount = 0;
+			long long bltSum = 0;
+
+			for (std::size_t i = g_frameCount - count; i < g_frameCount; ++i)
+			{
+				const auto& frame = getFrame(i);
+				if (0 != frame.qpcFlip)
+				{
+					const long long latency = frame.qpcPresent - frame.qpcFlip;
+					latencySum += latency;
+					latencyMax = std::max<long long>(latencyMax, latency);
+					++latencyCount;
+				}
+				bltSum += frame.qpcBltEnd - frame.qpcBltStart;
+			}
+
+			std::ostringstream oss;
+			oss << std::fixed << std::setprecision(1);
+			if (0 != latencyCount)
+			{
+				oss << "Latency " << toMs(latencySum / static_cast<long long>(latencyCount))
+					<< '/' << toMs(latencyMax) << " ms, ";
+			}
+			oss << "blt " << toMs(bltSum / static_cast<long long>(count)) << " ms";
+			return oss.str();
+		}
+
+		bool isEnabled()
+		{
+			return Config::Settings::FrameStats::OFF != Config::frameStats.get();
+		}
+
+		void onBltEnd()
+		{
+			if (isEnabled())
+			{
+				Compat::ScopedCriticalSection lock(g_cs);
+				g_currentFrame.qpcBltEnd = Time::queryPerformanceCounter();
+			}
+		}
+
+		void onBltStart()
+		{
+			if (isEnabled())
+			{
+				Compat::ScopedCriticalSection lock(g_cs);
+				g_currentFrame.qpcBltStart = Time::queryPerformanceCounter();
+			}
+		}
+
+		void onFlip()
+		{
+			if (isEnabled())
+			{
+				Compat::ScopedCriticalSection lock(g_cs);
+				if (0 == g_currentFrame.qpcFlip)
+				{
+					g_currentFrame.qpcFlip = Time::queryPerformanceCounter();
+				}
+			}
+		}
+
+		void onPresent(UINT vsyncCount)
+		{
+			if (isEnabled())
+			{
+				Compat::ScopedCriticalSection lock(g_cs);
+				g_currentFrame.qpcPresent = Time::queryPerformanceCounter();
+				g_currentFrame.vsyncCount = vsyncCount;
+				g_frames[g_frameCount % MAX_FRAMES] = g_currentFrame;
+				++g_frameCount;
+				g_currentFrame = {};
+			}
+		}
+
+		void onUpdateThreadWakeup()
+		{
+			if (isEnabled())
+			{
+				Compat::ScopedCriticalSection lock(g_cs);
+				g_currentFrame.qpcWakeup = Time::queryPerformanceCounter();
+			}
+		}
+	}
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+#include <Windows.h>
+
+namespace DDraw
+{
+	namespace FrameStats
+	{
+		void dump();
+		// Writes the frame history once every frame of the previous dump has been overwritten
+		void dumpIfFull();
+		std::string getSummary();
+		bool isEnabled();
+		void onBltEnd();
+		void onBltStart();
+		void onFlip();
+		void onPresent(UINT vsyncCount);
+		void onUpdateThreadWakeup();
+	}
+}
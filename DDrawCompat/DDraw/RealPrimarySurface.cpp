@@ -1,3 +1,5 @@
+#include <algorithm>
+#include <climits>
 #include <memory>
 #include <vector>
 
@@ -15,12 +17,14 @@
 #include <D3dDdi/SurfaceRepository.h>
 #include <DDraw/DirectDraw.h>
 #include <DDraw/DirectDrawSurface.h>
+#include <DDraw/FrameStats.h>
 #include <DDraw/IReleaseNotifier.h>
 #include <DDraw/RealPrimarySurface.h>
 #include <DDraw/ScopedThreadLock.h>
 #include <DDraw/Surfaces/PrimarySurface.h>
 #include <DDraw/Surfaces/TagSurface.h>
 #include <DDraw/Types.h>
+#include <DDraw/UpdateThreadPolicy.h>
 #include <Gdi/Caret.h>
 #include <Gdi/Cursor.h>
 #include <Gdi/Gdi.h>
@@ -36,6 +40,7 @@
 namespace
 {
 	const unsigned DELAYED_FLIP_MODE_TIMEOUT_MS = 200;
+	const long long VSYNC_PRESENT_MARGIN_MS = 2;
 
 	void onRelease();
 
@@ -53,12 +58,15 @@ namespace
 	DDraw::TagSurface* g_tagSurface = nullptr;
 
 	Compat::CriticalSection g_presentCs;
+	// The update thread blocks on g_updateEvent when none of these flags is set.
+	// Any code that sets one of them outside of the update thread must call signalUpdateThread afterwards.
 	bool g_isDelayedFlipPending = false;
 	bool g_isUpdatePending = false;
 	bool g_isUpdateReady = false;
 	DWORD g_lastUpdateThreadId = 0;
 	long long g_qpcLastUpdate = 0;
 	long long g_qpcUpdateStart = 0;
+	HANDLE g_updateEvent = nullptr;
 
 	long long g_qpcDelayedFlipEnd = 0;
 	UINT g_flipEndVsyncCount = 0;
@@ -322,6 +330,8 @@ namespace
 				auto configWindow = Gdi::GuiThread::getConfigWindow();
 				if (configWindow)
 				{
+					configWindow->updateFrameStats();
+					configWindow->updateMemoryUsage();
 					configWindow->update();
 				}
 
@@ -342,7 +352,9 @@ namespace
 
 		Gdi::Region excludeRegion(DDraw::PrimarySurface::getMonitorRect());
 		Gdi::Window::present(excludeRegion);
+		DDraw::FrameStats::onBltStart();
 		bltToPrimaryChain(*src);
+		DDraw::FrameStats::onBltEnd();
 	}
 
 	void updateNow(CompatWeakPtr<IDirectDrawSurface7> src)
@@ -362,6 +374,7 @@ namespace
 			*g_deviceWindowPtr = g_deviceWindow;
 		}
 		g_presentEndVsyncCount = D3dDdi::KernelModeThunks::getVsyncCounter() + 1;
+		DDraw::FrameStats::onPresent(g_presentEndVsyncCount - 1);
 	}
 
 	void updatePresentationWindowPos()
@@ -402,22 +415,61 @@ namespace
 			});
 	}
 
+	long long getQpcPresentDeadline(long long qpc)
+	{
+		auto qpcNextVsync = D3dDdi::KernelModeThunks::getQpcNextVsync(qpc);
+		return 0 == qpcNextVsync ? 0 : qpcNextVsync - Time::msToQpc(VSYNC_PRESENT_MARGIN_MS);
+	}
+
+	int getMsUntilPresentDeadline()
+	{
+		auto qpcNow = Time::queryPerformanceCounter();
+		auto qpcDeadline = getQpcPresentDeadline(qpcNow);
+		if (0 == qpcDeadline)
+		{
+			return INT_MAX;
+		}
+		return static_cast<int>(std::max<long long>(Time::qpcToMs(qpcDeadline - qpcNow), 0));
+	}
+
+	bool isUpdateQueued()
+	{
+		Compat::ScopedCriticalSection lock(g_presentCs);
+		return g_isUpdatePending || g_isUpdateReady || g_isDelayedFlipPending;
+	}
+
+	void signalUpdateThread()
+	{
+		if (g_updateEvent)
+		{
+			SetEvent(g_updateEvent);
+		}
+	}
+
 	unsigned WINAPI updateThreadProc(LPVOID /*lpParameter*/)
 	{
 		int msUntilUpdateReady = 0;
 		while (true)
 		{
-			if (msUntilUpdateReady > 0)
+			switch (DDraw::UpdateThreadPolicy::getWait(msUntilUpdateReady, isUpdateQueued()))
 			{
-				Sleep(1);
+			case DDraw::UpdateThreadPolicy::WAIT_TIMEOUT:
+				WaitForSingleObject(g_updateEvent, msUntilUpdateReady);
+				break;
+			case DDraw::UpdateThreadPolicy::WAIT_VSYNC:
+				D3dDdi::KernelModeThunks::waitForVsyncCounter(g_presentEndVsyncCount);
+				break;
+			default:
+				WaitForSingleObject(g_updateEvent, INFINITE);
+				break;
 			}
-			else
+
+			DDraw::FrameStats::onUpdateThreadWakeup();
 			{
-				D3dDdi::KernelModeThunks::waitForVsyncCounter(D3dDdi::KernelModeThunks::getVsyncCounter() + 1);
+				DDraw::ScopedThreadLock lock;
+				msUntilUpdateReady = DDraw::RealPrimarySurface::flush();
 			}
-
-			DDraw::ScopedThreadLock lock;
-			msUntilUpdateReady = DDraw::RealPrimarySurface::flush();
+			DDraw::FrameStats::dumpIfFull();
 		}
 	}
 }
@@ -518,6 +570,7 @@ namespace DDraw
 
 	HRESULT RealPrimarySurface::flip(CompatPtr<IDirectDrawSurface7> surfaceTargetOverride, DWORD flags)
 	{
+		FrameStats::onFlip();
 		const DWORD flipInterval = getFlipInterval(flags);
 		if (0 == flipInterval ||
 			Time::qpcToMs(Time::queryPerformanceCounter() - g_qpcLastUpdate) < DELAYED_FLIP_MODE_TIMEOUT_MS)
@@ -546,6 +599,7 @@ namespace DDraw
 		}
 
 		g_qpcDelayedFlipEnd = Time::queryPerformanceCounter();
+		signalUpdateThread();
 		return DD_OK;
 	}
 
@@ -573,9 +627,10 @@ namespace DDraw
 				else if (g_isDelayedFlipPending)
 				{
 					auto msSinceDelayedFlipEnd = Time::qpcToMs(Time::queryPerformanceCounter() - g_qpcDelayedFlipEnd);
-					if (msSinceDelayedFlipEnd < 3)
+					auto msUntilPresentDeadline = getMsUntilPresentDeadline();
+					if (msSinceDelayedFlipEnd < 3 && msUntilPresentDeadline > 0)
 					{
-						return 3 - static_cast<int>(msSinceDelayedFlipEnd);
+						return std::min<int>(3 - static_cast<int>(msSinceDelayedFlipEnd), msUntilPresentDeadline);
 					}
 					g_isDelayedFlipPending = false;
 					g_isUpdateReady = true;
@@ -668,6 +723,7 @@ namespace DDraw
 
 	void RealPrimarySurface::init()
 	{
+		g_updateEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
 		Dll::createThread(&updateThreadProc, nullptr, THREAD_PRIORITY_TIME_CRITICAL);
 	}
 
@@ -718,6 +774,7 @@ namespace DDraw
 			g_isUpdatePending = true;
 			g_isDelayedFlipPending = false;
 			g_lastUpdateThreadId = GetCurrentThreadId();
+			signalUpdateThread();
 		}
 		g_isUpdateReady = false;
 	}
@@ -741,6 +798,7 @@ namespace DDraw
 		{
 			g_isUpdateReady = true;
 			g_isDelayedFlipPending = false;
+			signalUpdateThread();
 		}
 	}
 
@@ -798,6 +856,12 @@ namespace DDraw
 			return;
 		}
 		g_qpcPrevWaitEnd = qpcWaitEnd;
+
+		auto qpcPresentDeadline = getQpcPresentDeadline(qpcWaitEnd - Time::msToQpc(VSYNC_PRESENT_MARGIN_MS));
+		if (0 != qpcPresentDeadline && qpcPresentDeadline < qpcWaitEnd)
+		{
+			qpcWaitEnd = std::max<long long>(qpcPresentDeadline, qpcNow);
+		}
 		g_qpcDelayedFlipEnd = qpcWaitEnd;
 
 		Compat::ScopedThreadPriority prio(THREAD_PRIORITY_TIME_CRITICAL);
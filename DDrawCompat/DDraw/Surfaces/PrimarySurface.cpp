@@ -7,6 +7,7 @@
 #include <D3dDdi/SurfaceRepository.h>
 #include <DDraw/DirectDraw.h>
 #include <DDraw/DirectDrawSurface.h>
+#include <DDraw/FrameStats.h>
 #include <DDraw/RealPrimarySurface.h>
 #include <DDraw/Surfaces/PrimarySurface.h>
 #include <DDraw/Surfaces/PrimarySurfaceImpl.h>
@@ -83,6 +84,7 @@ namespace DDraw
 		s_palette = nullptr;
 
 		DDraw::RealPrimarySurface::release();
+		DDraw::FrameStats::dump();
 	}
 
 	template <typename TDirectDraw, typename TSurface, typename TSurfaceDesc>
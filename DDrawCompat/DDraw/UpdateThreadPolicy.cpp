@@ -0,0 +1,16 @@
+#include <DDraw/UpdateThreadPolicy.h>
+
+namespace DDraw
+{
+	namespace UpdateThreadPolicy
+	{
+		Wait getWait(int msUntilUpdateReady, bool isUpdateQueued)
+		{
+			if (msUntilUpdateReady > 0)
+			{
+				return WAIT_TIMEOUT;
+			}
+			return isUpdateQueued ? WAIT_VSYNC : WAIT_EVENT;
+		}
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+namespace DDraw
+{
+	namespace UpdateThreadPolicy
+	{
+		enum Wait
+		{
+			// Block on the update event until a writer of the update flags signals it
+			WAIT_EVENT,
+			// Wait on the update event for at most msUntilUpdateReady
+			WAIT_TIMEOUT,
+			// Wait until the vsync counter reaches the end of the last present
+			WAIT_VSYNC
+		};
+
+		// msUntilUpdateReady is the result of the previous RealPrimarySurface::flush
+		Wait getWait(int msUntilUpdateReady, bool isUpdateQueued);
+	}
+}
@@ -5,6 +5,29 @@
 #include <DDraw/Surfaces/PrimarySurface.h>
 #include <Gdi/CompatDc.h>
 #include <Gdi/Dc.h>
+#include <Gdi/VirtualScreen.h>
+
+namespace
+{
+	RECT getDirtyRect(HDC dc, bool isBoundsRectEnabled)
+	{
+		const RECT virtualScreenBounds = Gdi::VirtualScreen::getBounds();
+		RECT rect = {};
+		if (isBoundsRectEnabled && DCB_SET == GetBoundsRect(dc, &rect, DCB_RESET))
+		{
+			LPtoDP(dc, reinterpret_cast<POINT*>(&rect), 2);
+		}
+		else
+		{
+			rect = { 0, 0, virtualScreenBounds.right - virtualScreenBounds.left,
+				virtualScreenBounds.bottom - virtualScreenBounds.top };
+		}
+
+		const RECT monitorRect = DDraw::PrimarySurface::getMonitorRect();
+		OffsetRect(&rect, virtualScreenBounds.left - monitorRect.left, virtualScreenBounds.top - monitorRect.top);
+		return rect;
+	}
+}
 
 namespace Gdi
 {
@@ -12,6 +35,7 @@ namespace Gdi
 		: m_origDc(dc)
 		, m_compatDc(Gdi::Dc::getDc(dc))
 		, m_isReadOnly(isReadOnly)
+		, m_isBoundsRectEnabled(false)
 	{
 		if (m_compatDc)
 		{
@@ -26,6 +50,8 @@ namespace Gdi
 				else
 				{
 					gdiResource->prepareForCpuWrite(0);
+					SetBoundsRect(m_compatDc, nullptr, DCB_RESET | DCB_ENABLE);
+					m_isBoundsRectEnabled = true;
 				}
 			}
 		}
@@ -41,6 +67,14 @@ namespace Gdi
 		{
 			D3dDdi::ScopedCriticalSection lock;
 			auto gdiResource = D3dDdi::Device::getGdiResource();
+			if (!m_isReadOnly && gdiResource)
+			{
+				gdiResource->addDirtyRect(0, getDirtyRect(m_compatDc, m_isBoundsRectEnabled));
+			}
+			if (m_isBoundsRectEnabled)
+			{
+				SetBoundsRect(m_compatDc, nullptr, DCB_DISABLE);
+			}
 			if (!m_isReadOnly && (!gdiResource || DDraw::PrimarySurface::getFrontResource() == *gdiResource))
 			{
 				DDraw::RealPrimarySurface::scheduleUpdate();
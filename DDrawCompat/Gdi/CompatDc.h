@@ -23,5 +23,6 @@ namespace Gdi
 		HDC m_origDc;
 		HDC m_compatDc;
 		bool m_isReadOnly;
+		bool m_isBoundsRectEnabled;
 	};
 }
@@ -4,6 +4,8 @@
 #include <Common/Hook.h>
 #include <Common/Log.h>
 #include <Config/Config.h>
+#include <D3dDdi/MemoryUsage.h>
+#include <DDraw/FrameStats.h>
 #include <Gdi/GuiThread.h>
 #include <Input/Input.h>
 #include <Overlay/ConfigWindow.h>
@@ -17,7 +19,7 @@ namespace
 namespace Overlay
 {
 	ConfigWindow::ConfigWindow()
-		: Window(nullptr, { 0, 0, SettingControl::TOTAL_WIDTH, 430 }, Config::configHotKey.get())
+		: Window(nullptr, { 0, 0, SettingControl::TOTAL_WIDTH, 460 }, Config::configHotKey.get())
 		, m_buttonCount(0)
 		, m_focus(nullptr)
 	{
@@ -47,6 +49,16 @@ namespace Overlay
 		m_importButton = addButton("Import", onImport);
 		m_resetAllButton = addButton("Reset all", onResetAll);
 
+		if (DDraw::FrameStats::isEnabled())
+		{
+			r = { 0, m_rect.bottom - (22 + BORDER),
+				m_rect.right - static_cast<LONG>(m_buttonCount * (80 + BORDER)), m_rect.bottom - BORDER };
+			m_frameStatsLabel.reset(new LabelControl(*this, r, std::string(), 0));
+		}
+
+		r = { 0, m_rect.bottom - 2 * (22 + BORDER), m_rect.right, m_rect.bottom - (22 + 2 * BORDER) };
+		m_memoryUsageLabel.reset(new LabelControl(*this, r, std::string(), 0));
+
 		std::ifstream f(Config::Parser::getOverlayConfigPath());
 		std::ostringstream oss;
 		oss << f.rdbuf();
@@ -220,4 +232,34 @@ namespace Overlay
 		m_importButton->setEnabled(enableImport);
 		m_resetAllButton->setEnabled(enableReset);
 	}
+
+	void ConfigWindow::updateFrameStats()
+	{
+		if (!m_frameStatsLabel || !isVisible())
+		{
+			return;
+		}
+
+		auto summary(DDraw::FrameStats::getSummary());
+		if (summary != m_frameStatsLabel->getLabel())
+		{
+			m_frameStatsLabel->setLabel(summary);
+			m_frameStatsLabel->invalidate();
+		}
+	}
+
+	void ConfigWindow::updateMemoryUsage()
+	{
+		if (!m_memoryUsageLabel || !isVisible())
+		{
+			return;
+		}
+
+		auto summary(D3dDdi::MemoryUsage::getSummary());
+		if (summary != m_memoryUsageLabel->getLabel())
+		{
+			m_memoryUsageLabel->setLabel(summary);
+			m_memoryUsageLabel->invalidate();
+		}
+	}
 }
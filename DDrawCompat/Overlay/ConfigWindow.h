@@ -20,6 +20,8 @@ namespace Overlay
 
 		void setFocus(SettingControl* control);
 		void updateButtons();
+		void updateFrameStats();
+		void updateMemoryUsage();
 
 	private:
 		static void onClose(Control& control);
@@ -41,7 +43,9 @@ namespace Overlay
 		std::unique_ptr<ButtonControl> m_captionCloseButton;
 		std::unique_ptr<ButtonControl> m_closeButton;
 		std::unique_ptr<ButtonControl> m_exportButton;
+		std::unique_ptr<LabelControl> m_frameStatsLabel;
 		std::unique_ptr<ButtonControl> m_importButton;
+		std::unique_ptr<LabelControl> m_memoryUsageLabel;
 		std::unique_ptr<ButtonControl> m_resetAllButton;
 		std::list<SettingControl> m_settingControls;
 		SettingControl* m_focus;
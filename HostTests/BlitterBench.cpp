@@ -0,0 +1,95 @@
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+#include <BlitterHost.h>
+#include <Harness.h>
+
+namespace
+{
+	struct Resolution
+	{
+		DWORD width;
+		DWORD height;
+	};
+
+	const Resolution g_resolutions[] = {
+		{ 320, 200 }, { 640, 480 }, { 800, 600 }, { 1024, 768 },
+		{ 1280, 1024 }, { 1920, 1080 }, { 2560, 1440 }, { 3840, 2160 }
+	};
+
+	enum Flags
+	{
+		STRETCH = 1,
+		MIRROR = 2,
+		DST_COLOR_KEY = 4,
+		SRC_COLOR_KEY = 8,
+		FLAG_COMBINATIONS = 16
+	};
+
+	void printFlags(unsigned flags)
+	{
+		std::printf("%-8s%-7s%-7s%-7s",
+			(flags & STRETCH) ? "stretch" : "-",
+			(flags & MIRROR) ? "mirror" : "-",
+			(flags & DST_COLOR_KEY) ? "dstkey" : "-",
+			(flags & SRC_COLOR_KEY) ? "srckey" : "-");
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const bool isQuick = Harness::isQuick(argc, argv);
+	const double minSeconds = isQuick ? 0.0 : 0.05;
+	const Resolution* resolutionsEnd = isQuick ? g_resolutions + 2 : std::end(g_resolutions);
+
+	std::printf("%-4s %3s %11s  %-29s %12s\n", "tier", "bpp", "dst size", "flags", "Mpixels/s");
+	for (int avx2 = 0; avx2 <= 1; ++avx2)
+	{
+		DDraw::BlitterKernels::enableAvx2(0 != avx2);
+		if (avx2 && !DDraw::BlitterKernels::isAvx2Enabled())
+		{
+			break;
+		}
+
+		for (DWORD bytesPerPixel = 1; bytesPerPixel <= 4; ++bytesPerPixel)
+		{
+			for (const Resolution* res = g_resolutions; res != resolutionsEnd; ++res)
+			{
+				const DWORD pitch = res->width * bytesPerPixel;
+				std::vector<BYTE> src(pitch * res->height + 64, 0x55);
+				std::vector<BYTE> dst(pitch * res->height, 0xAA);
+				for (std::size_t i = 0; i < src.size(); i += 7)
+				{
+					src[i] = 0;
+				}
+				const DWORD colorKey = 0;
+
+				for (unsigned flags = 0; flags < FLAG_COMBINATIONS; ++flags)
+				{
+					// Stretched blits scale a half size source up to the destination size
+					const LONG srcWidth = static_cast<LONG>((flags & STRETCH) ? res->width / 2 : res->width);
+					const LONG srcHeight = static_cast<LONG>((flags & STRETCH) ? res->height / 2 : res->height);
+					const double seconds = Harness::measure([&]()
+						{
+							BlitterHost::blt(dst.data(), pitch, res->width, res->height,
+								src.data(), pitch, (flags & MIRROR) ? -srcWidth : srcWidth, srcHeight, bytesPerPixel,
+								(flags & DST_COLOR_KEY) ? &colorKey : nullptr, (flags & SRC_COLOR_KEY) ? &colorKey : nullptr);
+						}, minSeconds);
+
+					std::printf("%-4s %3u %5ux%-5u  ", avx2 ? "avx2" : "sse", bytesPerPixel * 8, res->width, res->height);
+					printFlags(flags);
+					std::printf(" %12.1f\n", res->width * res->height / seconds / 1e6);
+				}
+
+				const double seconds = Harness::measure([&]()
+					{
+						DDraw::BlitterKernels::colorFill(dst.data(), pitch, res->width, res->height, bytesPerPixel, 0x12345678);
+					}, minSeconds);
+				std::printf("%-4s %3u %5ux%-5u  %-29s %12.1f\n", avx2 ? "avx2" : "sse", bytesPerPixel * 8,
+					res->width, res->height, "color fill", res->width * res->height / seconds / 1e6);
+			}
+		}
+	}
+	return 0;
+}
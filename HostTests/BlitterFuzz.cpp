@@ -0,0 +1,222 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+#include <BlitterHost.h>
+#include <Harness.h>
+
+namespace
+{
+	const DWORD GUARD = 64;
+
+	DWORD readPixel(const BYTE* p, DWORD bytesPerPixel)
+	{
+		DWORD value = 0;
+		std::memcpy(&value, p, bytesPerPixel);
+		return value;
+	}
+
+	void writePixel(BYTE* p, DWORD bytesPerPixel, DWORD value)
+	{
+		std::memcpy(p, &value, bytesPerPixel);
+	}
+
+	DWORD getColorKeyMask(DWORD bytesPerPixel)
+	{
+		return 1 == bytesPerPixel ? 0xFF : 2 == bytesPerPixel ? 0xFFFF : 0xFFFFFF;
+	}
+
+	// Scalar reference with the same 16.16 fixed point sampling as the vectorized kernels
+	void referenceBlt(BYTE* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const BYTE* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+		DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey)
+	{
+		const DWORD absSrcWidth = std::abs(srcWidth);
+		const DWORD absSrcHeight = std::abs(srcHeight);
+		int deltaX = (absSrcWidth << 16) / dstWidth;
+		int deltaY = (absSrcHeight << 16) / dstHeight;
+		int offsetX = deltaX / 2;
+		int offsetY = deltaY / 2;
+		if (srcWidth < 0)
+		{
+			offsetX += static_cast<int>(dstWidth - 1) * deltaX;
+			deltaX = -deltaX;
+		}
+		if (srcHeight < 0)
+		{
+			offsetY += static_cast<int>(dstHeight - 1) * deltaY;
+			deltaY = -deltaY;
+		}
+
+		const DWORD mask = getColorKeyMask(bytesPerPixel);
+		for (DWORD y = 0; y < dstHeight; ++y)
+		{
+			const int srcY = (offsetY + static_cast<int>(y) * deltaY) >> 16;
+			for (DWORD x = 0; x < dstWidth; ++x)
+			{
+				const int srcX = (offsetX + static_cast<int>(x) * deltaX) >> 16;
+				BYTE* d = dst + y * dstPitch + x * bytesPerPixel;
+				const DWORD s = readPixel(src + srcY * static_cast<int>(srcPitch) + srcX * static_cast<int>(bytesPerPixel),
+					bytesPerPixel);
+				if ((!dstColorKey || (readPixel(d, bytesPerPixel) & mask) == (*dstColorKey & mask)) &&
+					(!srcColorKey || (s & mask) != (*srcColorKey & mask)))
+				{
+					writePixel(d, bytesPerPixel, s);
+				}
+			}
+		}
+	}
+
+	void fillRandom(Harness::Random& random, std::vector<BYTE>& buffer, const DWORD* colors, DWORD bytesPerPixel)
+	{
+		for (std::size_t i = 0; i + bytesPerPixel <= buffer.size(); i += bytesPerPixel)
+		{
+			writePixel(&buffer[i], bytesPerPixel, colors[random.range(0, 3)]);
+		}
+	}
+
+	struct Case
+	{
+		DWORD bytesPerPixel;
+		DWORD dstWidth;
+		DWORD dstHeight;
+		LONG srcWidth;
+		LONG srcHeight;
+		bool useDstColorKey;
+		bool useSrcColorKey;
+		DWORD dstColorKey;
+		DWORD srcColorKey;
+	};
+
+	Case getRandomCase(Harness::Random& random, DWORD* colors)
+	{
+		Case c = {};
+		c.bytesPerPixel = random.range(1, 4);
+		c.dstWidth = random.chance(20) ? random.range(1, 8) : random.range(1, 300);
+		c.dstHeight = random.range(1, 12);
+		c.srcWidth = random.chance(50) ? c.dstWidth : random.range(1, 300);
+		c.srcHeight = random.chance(50) ? c.dstHeight : random.range(1, 24);
+		c.srcWidth = random.chance(25) ? -c.srcWidth : c.srcWidth;
+		c.srcHeight = random.chance(25) ? -c.srcHeight : c.srcHeight;
+		for (DWORD i = 0; i < 4; ++i)
+		{
+			colors[i] = random.next();
+		}
+		c.useDstColorKey = random.chance(25);
+		c.useSrcColorKey = random.chance(25);
+		c.dstColorKey = colors[random.range(0, 3)];
+		c.srcColorKey = colors[random.range(0, 3)];
+		return c;
+	}
+
+	void testSeparateSurfaces(Harness::Random& random)
+	{
+		DWORD colors[4] = {};
+		const Case c = getRandomCase(random, colors);
+		const DWORD dstPitch = c.dstWidth * c.bytesPerPixel + random.range(0, 16);
+		const DWORD srcPitch = std::abs(c.srcWidth) * c.bytesPerPixel + random.range(0, 16);
+
+		std::vector<BYTE> src(2 * GUARD + srcPitch * std::abs(c.srcHeight));
+		std::vector<BYTE> dst(2 * GUARD + dstPitch * c.dstHeight);
+		fillRandom(random, src, colors, c.bytesPerPixel);
+		fillRandom(random, dst, colors, c.bytesPerPixel);
+		std::vector<BYTE> expected(dst);
+
+		const DWORD* dstColorKey = c.useDstColorKey ? &c.dstColorKey : nullptr;
+		const DWORD* srcColorKey = c.useSrcColorKey ? &c.srcColorKey : nullptr;
+		referenceBlt(expected.data() + GUARD, dstPitch, c.dstWidth, c.dstHeight,
+			src.data() + GUARD, srcPitch, c.srcWidth, c.srcHeight, c.bytesPerPixel, dstColorKey, srcColorKey);
+		BlitterHost::blt(dst.data() + GUARD, dstPitch, c.dstWidth, c.dstHeight,
+			src.data() + GUARD, srcPitch, c.srcWidth, c.srcHeight, c.bytesPerPixel, dstColorKey, srcColorKey);
+
+		const auto mismatch = std::mismatch(dst.begin(), dst.end(), expected.begin());
+		HARNESS_CHECK(mismatch.first == dst.end(),
+			"bpp %u, %ux%u <- %dx%d, pitch %u/%u, keys %d/%d, byte %d",
+			c.bytesPerPixel, c.dstWidth, c.dstHeight, c.srcWidth, c.srcHeight, dstPitch, srcPitch,
+			c.useDstColorKey, c.useSrcColorKey, static_cast<int>(mismatch.first - dst.begin()) - static_cast<int>(GUARD));
+	}
+
+	void testOverlappingSurfaces(Harness::Random& random)
+	{
+		DWORD colors[4] = {};
+		const Case c = getRandomCase(random, colors);
+		const DWORD width = std::max<DWORD>(c.dstWidth, std::abs(c.srcWidth)) + random.range(0, 32);
+		const DWORD height = std::max<DWORD>(c.dstHeight, std::abs(c.srcHeight)) + random.range(0, 8);
+		const DWORD pitch = width * c.bytesPerPixel + random.range(0, 16);
+
+		std::vector<BYTE> surface(2 * GUARD + pitch * height);
+		fillRandom(random, surface, colors, c.bytesPerPixel);
+		std::vector<BYTE> expected(surface);
+		const std::vector<BYTE> origSurface(surface);
+
+		const DWORD dstOffset = GUARD + random.range(0, height - c.dstHeight) * pitch +
+			random.range(0, width - c.dstWidth) * c.bytesPerPixel;
+		const DWORD srcOffset = GUARD + random.range(0, height - std::abs(c.srcHeight)) * pitch +
+			random.range(0, width - std::abs(c.srcWidth)) * c.bytesPerPixel;
+
+		const DWORD* dstColorKey = c.useDstColorKey ? &c.dstColorKey : nullptr;
+		const DWORD* srcColorKey = c.useSrcColorKey ? &c.srcColorKey : nullptr;
+		referenceBlt(expected.data() + dstOffset, pitch, c.dstWidth, c.dstHeight,
+			origSurface.data() + srcOffset, pitch, c.srcWidth, c.srcHeight, c.bytesPerPixel, dstColorKey, srcColorKey);
+		BlitterHost::blt(surface.data() + dstOffset, pitch, c.dstWidth, c.dstHeight,
+			surface.data() + srcOffset, pitch, c.srcWidth, c.srcHeight, c.bytesPerPixel, dstColorKey, srcColorKey);
+
+		const auto mismatch = std::mismatch(surface.begin(), surface.end(), expected.begin());
+		HARNESS_CHECK(mismatch.first == surface.end(),
+			"overlapping, bpp %u, %ux%u <- %dx%d, pitch %u, offsets %u/%u, keys %d/%d, byte %d",
+			c.bytesPerPixel, c.dstWidth, c.dstHeight, c.srcWidth, c.srcHeight, pitch, dstOffset, srcOffset,
+			c.useDstColorKey, c.useSrcColorKey, static_cast<int>(mismatch.first - surface.begin()));
+	}
+
+	void testColorFill(Harness::Random& random)
+	{
+		const DWORD bytesPerPixel = random.range(1, 4);
+		const DWORD width = random.chance(20) ? random.range(1, 8) : random.range(1, 300);
+		const DWORD height = random.range(1, 12);
+		const DWORD pitch = width * bytesPerPixel + random.range(0, 16);
+		const DWORD color = random.chance(20) ? (random.next() & 0xFF) * 0x01010101 : random.next();
+
+		std::vector<BYTE> dst(2 * GUARD + pitch * height);
+		for (auto& b : dst)
+		{
+			b = static_cast<BYTE>(random.next());
+		}
+		std::vector<BYTE> expected(dst);
+		for (DWORD y = 0; y < height; ++y)
+		{
+			for (DWORD x = 0; x < width; ++x)
+			{
+				writePixel(&expected[GUARD + y * pitch + x * bytesPerPixel], bytesPerPixel, color);
+			}
+		}
+
+		DDraw::BlitterKernels::colorFill(dst.data() + GUARD, pitch, width, height, bytesPerPixel, color);
+		HARNESS_CHECK(dst == expected, "color fill, bpp %u, %ux%u, pitch %u, color %08x",
+			bytesPerPixel, width, height, pitch, color);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned iterations = Harness::isQuick(argc, argv) ? 2000 : 20000;
+	for (int avx2 = 0; avx2 <= 1; ++avx2)
+	{
+		DDraw::BlitterKernels::enableAvx2(0 != avx2);
+		if (avx2 && !DDraw::BlitterKernels::isAvx2Enabled())
+		{
+			std::printf("AVX2 is not supported, skipping the AVX2 tier\n");
+			break;
+		}
+
+		Harness::Random random(1234 + avx2);
+		for (unsigned i = 0; i < iterations; ++i)
+		{
+			testSeparateSurfaces(random);
+			testOverlappingSurfaces(random);
+			testColorFill(random);
+		}
+	}
+	return Harness::report("BlitterFuzz");
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include <DDraw/BlitterKernels.h>
+
+namespace BlitterHost
+{
+	// Same composition as DDraw::Blitter::blt, without the stretch table cache and the worker pool
+	inline void blt(void* dst, DWORD dstPitch, DWORD dstWidth, DWORD dstHeight,
+		const void* src, DWORD srcPitch, LONG srcWidth, LONG srcHeight,
+		DWORD bytesPerPixel, const DWORD* dstColorKey, const DWORD* srcColorKey)
+	{
+		using namespace DDraw::BlitterKernels;
+		thread_local std::vector<BYTE> overlapBuffer;
+		thread_local std::vector<int> columns;
+
+		if (Overlap::DONE == stageOverlappingSrc(dst, dstPitch, dstWidth, dstHeight,
+			src, srcPitch, srcWidth, srcHeight, bytesPerPixel, dstColorKey || srcColorKey, overlapBuffer))
+		{
+			return;
+		}
+
+		StretchParams stretch = {};
+		BltArgs args = getBltArgs(dst, dstPitch, dstWidth, dstHeight,
+			src, srcPitch, srcWidth, srcHeight, bytesPerPixel, dstColorKey, srcColorKey, stretch);
+		if (stretch.srcWidth != stretch.dstWidth)
+		{
+			fillStretchColumns(columns, stretch);
+			args.columns = columns.data();
+		}
+		executeBlt(args);
+	}
+}
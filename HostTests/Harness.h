@@ -0,0 +1,82 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <random>
+
+namespace Harness
+{
+	inline int g_failures = 0;
+
+	inline bool isQuick(int argc, char* argv[])
+	{
+		for (int i = 1; i < argc; ++i)
+		{
+			if (0 == std::strcmp(argv[i], "--quick"))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	inline int report(const char* name)
+	{
+		if (0 != g_failures)
+		{
+			std::printf("%s: %d failure(s)\n", name, g_failures);
+			return 1;
+		}
+		std::printf("%s: passed\n", name);
+		return 0;
+	}
+
+	class Random
+	{
+	public:
+		Random(uint32_t seed = 1) : m_engine(seed) {}
+
+		uint32_t next() { return m_engine(); }
+		uint32_t range(uint32_t min, uint32_t max) { return min + m_engine() % (max - min + 1); }
+		bool chance(uint32_t percent) { return m_engine() % 100 < percent; }
+		float real(float min, float max) { return std::uniform_real_distribution<float>(min, max)(m_engine); }
+
+	private:
+		std::mt19937 m_engine;
+	};
+
+	// Runs func repeatedly for at least minSeconds and returns the average time per call in seconds
+	template <typename Func>
+	double measure(Func func, double minSeconds)
+	{
+		typedef std::chrono::steady_clock Clock;
+		func();
+		unsigned iterations = 0;
+		const auto start = Clock::now();
+		double elapsed = 0;
+		do
+		{
+			func();
+			++iterations;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < minSeconds);
+		return elapsed / iterations;
+	}
+}
+
+#define HARNESS_CHECK(condition, ...) \
+	do \
+	{ \
+		if (!(condition)) \
+		{ \
+			++Harness::g_failures; \
+			if (Harness::g_failures <= 20) \
+			{ \
+				std::printf("%s:%d: check failed: %s: ", __FILE__, __LINE__, #condition); \
+				std::printf(__VA_ARGS__); \
+				std::printf("\n"); \
+			} \
+		} \
+	} while (false)
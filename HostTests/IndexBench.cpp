@@ -0,0 +1,83 @@
+#include <cstdio>
+#include <vector>
+
+#include <D3dDdi/IndexKernels.h>
+#include <Harness.h>
+#include <IndexReference.h>
+
+namespace
+{
+	// Terrain renderers draw many short strips/fans per frame as well as a few long ones
+	const UINT g_primitiveCounts[] = { 8, 64, 1024, 65535 };
+
+	void print(const char* name, UINT primitiveCount, double scalarSeconds, double vectorSeconds)
+	{
+		std::printf("%-16s %10u %12.1f %12.1f %8.2fx\n", name, primitiveCount,
+			primitiveCount / scalarSeconds / 1e6, primitiveCount / vectorSeconds / 1e6, scalarSeconds / vectorSeconds);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const double minSeconds = Harness::isQuick(argc, argv) ? 0.0 : 0.1;
+	std::printf("%-16s %10s %12s %12s %9s\n", "conversion", "primitives", "scalar Mp/s", "simd Mp/s", "speedup");
+
+	std::vector<UINT> indices;
+	std::vector<UINT> output;
+	for (UINT primitiveCount : g_primitiveCounts)
+	{
+		output.resize(primitiveCount * 3);
+		indices.reserve(primitiveCount * 3);
+
+		double scalar = Harness::measure([&]()
+			{
+				indices.clear();
+				IndexReference::generateTriangleStripList(indices, 0, primitiveCount);
+			}, minSeconds);
+		double vector = Harness::measure([&]()
+			{
+				D3dDdi::IndexKernels::generateTriangleStripList(output.data(), 0, primitiveCount);
+			}, minSeconds);
+		print("strip generate", primitiveCount, scalar, vector);
+
+		scalar = Harness::measure([&]()
+			{
+				indices.clear();
+				IndexReference::generateTriangleFanList(indices, 0, primitiveCount);
+			}, minSeconds);
+		vector = Harness::measure([&]()
+			{
+				D3dDdi::IndexKernels::generateTriangleFanList(output.data(), 0, primitiveCount);
+			}, minSeconds);
+		print("fan generate", primitiveCount, scalar, vector);
+
+		std::vector<UINT> src(primitiveCount + 2);
+		for (UINT i = 0; i < src.size(); ++i)
+		{
+			src[i] = i * 7 % 65536;
+		}
+
+		scalar = Harness::measure([&]()
+			{
+				indices.assign(src.begin(), src.end());
+				IndexReference::convertTriangleStripToList(indices, 0, primitiveCount);
+			}, minSeconds);
+		vector = Harness::measure([&]()
+			{
+				D3dDdi::IndexKernels::convertTriangleStripToList(output.data(), src.data(), primitiveCount);
+			}, minSeconds);
+		print("strip convert", primitiveCount, scalar, vector);
+
+		scalar = Harness::measure([&]()
+			{
+				indices.assign(src.begin(), src.end());
+				IndexReference::convertTriangleFanToList(indices, 0, primitiveCount);
+			}, minSeconds);
+		vector = Harness::measure([&]()
+			{
+				D3dDdi::IndexKernels::convertTriangleFanToList(output.data(), src.data(), primitiveCount);
+			}, minSeconds);
+		print("fan convert", primitiveCount, scalar, vector);
+	}
+	return 0;
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+
+#include <Common/Portability.h>
+
+// The scalar strip/fan to list conversions that D3dDdi::DrawPrimitive used before D3dDdi::IndexKernels.
+// The indexed variants convert in place, backwards from the end of the batch.
+namespace IndexReference
+{
+	inline void convertTriangleFanToList(std::vector<UINT>& indices, UINT startPrimitive, UINT primitiveCount)
+	{
+		const UINT totalPrimitiveCount = startPrimitive + primitiveCount;
+		indices.resize(totalPrimitiveCount * 3);
+
+		int startIndexPos = startPrimitive * 3;
+		int oldIndexPos = startIndexPos + primitiveCount - 1;
+		int newIndexPos = (totalPrimitiveCount - 1) * 3;
+		const UINT startIndex = indices[startIndexPos];
+
+		while (newIndexPos > startIndexPos)
+		{
+			indices[newIndexPos + 2] = startIndex;
+			indices[newIndexPos + 1] = indices[oldIndexPos + 2];
+			indices[newIndexPos] = indices[oldIndexPos + 1];
+			newIndexPos -= 3;
+			oldIndexPos--;
+		}
+
+		indices[newIndexPos] = indices[oldIndexPos + 1];
+		indices[newIndexPos + 1] = indices[oldIndexPos + 2];
+		indices[newIndexPos + 2] = startIndex;
+	}
+
+	inline void convertTriangleStripToList(std::vector<UINT>& indices, UINT startPrimitive, UINT primitiveCount)
+	{
+		const UINT totalPrimitiveCount = startPrimitive + primitiveCount;
+		indices.resize(totalPrimitiveCount * 3);
+
+		int oldIndexPos = startPrimitive * 3 + primitiveCount - 2;
+		int newIndexPos = (totalPrimitiveCount - 2) * 3;
+
+		if (0 != primitiveCount % 2)
+		{
+			indices[newIndexPos + 5] = indices[oldIndexPos + 3];
+			indices[newIndexPos + 4] = indices[oldIndexPos + 2];
+			indices[newIndexPos + 3] = indices[oldIndexPos + 1];
+			newIndexPos -= 3;
+			oldIndexPos--;
+		}
+
+		while (newIndexPos >= oldIndexPos)
+		{
+			indices[newIndexPos + 5] = indices[oldIndexPos + 2];
+			indices[newIndexPos + 4] = indices[oldIndexPos + 3];
+			indices[newIndexPos + 3] = indices[oldIndexPos + 1];
+			indices[newIndexPos + 2] = indices[oldIndexPos + 2];
+			indices[newIndexPos + 1] = indices[oldIndexPos + 1];
+			indices[newIndexPos] = indices[oldIndexPos];
+			newIndexPos -= 6;
+			oldIndexPos -= 2;
+		}
+	}
+
+	inline void generateTriangleFanList(std::vector<UINT>& indices, UINT base, UINT primitiveCount)
+	{
+		for (UINT i = base; i < base + primitiveCount; ++i)
+		{
+			indices.push_back(i + 1);
+			indices.push_back(i + 2);
+			indices.push_back(base);
+		}
+	}
+
+	inline void generateTriangleStripList(std::vector<UINT>& indices, UINT base, UINT primitiveCount)
+	{
+		UINT i = base;
+		for (; i < base + primitiveCount - 1; i += 2)
+		{
+			indices.push_back(i);
+			indices.push_back(i + 1);
+			indices.push_back(i + 2);
+			indices.push_back(i + 1);
+			indices.push_back(i + 3);
+			indices.push_back(i + 2);
+		}
+		if (i < base + primitiveCount)
+		{
+			indices.push_back(i);
+			indices.push_back(i + 1);
+			indices.push_back(i + 2);
+		}
+	}
+}
@@ -0,0 +1,62 @@
+#include <vector>
+
+#include <D3dDdi/IndexKernels.h>
+#include <Harness.h>
+#include <IndexReference.h>
+
+namespace
+{
+	void testPrimitiveCount(Harness::Random& random, UINT primitiveCount)
+	{
+		const UINT base = random.range(0, 100000);
+		std::vector<UINT> expected;
+		std::vector<UINT> actual(primitiveCount * 3);
+
+		IndexReference::generateTriangleStripList(expected, base, primitiveCount);
+		D3dDdi::IndexKernels::generateTriangleStripList(actual.data(), base, primitiveCount);
+		HARNESS_CHECK(actual == expected, "strip generation, %u primitives", primitiveCount);
+
+		expected.clear();
+		IndexReference::generateTriangleFanList(expected, base, primitiveCount);
+		D3dDdi::IndexKernels::generateTriangleFanList(actual.data(), base, primitiveCount);
+		HARNESS_CHECK(actual == expected, "fan generation, %u primitives", primitiveCount);
+
+		// The source strip/fan follows earlier primitives already converted to a list, as in a batch
+		const UINT startPrimitive = random.range(0, 4);
+		std::vector<UINT> batch(startPrimitive * 3 + primitiveCount + 2);
+		for (auto& index : batch)
+		{
+			index = random.range(0, 65535);
+		}
+		const std::vector<UINT> src(batch.begin() + startPrimitive * 3, batch.end());
+
+		expected = batch;
+		IndexReference::convertTriangleStripToList(expected, startPrimitive, primitiveCount);
+		HARNESS_CHECK(expected.size() == (startPrimitive + primitiveCount) * 3, "strip reference size");
+		std::vector<UINT> converted(batch.begin(), batch.begin() + startPrimitive * 3);
+		converted.resize(expected.size());
+		D3dDdi::IndexKernels::convertTriangleStripToList(converted.data() + startPrimitive * 3, src.data(), primitiveCount);
+		HARNESS_CHECK(converted == expected, "strip conversion, %u + %u primitives", startPrimitive, primitiveCount);
+
+		expected = batch;
+		IndexReference::convertTriangleFanToList(expected, startPrimitive, primitiveCount);
+		D3dDdi::IndexKernels::convertTriangleFanToList(converted.data() + startPrimitive * 3, src.data(), primitiveCount);
+		HARNESS_CHECK(converted == expected, "fan conversion, %u + %u primitives", startPrimitive, primitiveCount);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	Harness::Random random(5678);
+	for (UINT primitiveCount = 1; primitiveCount <= 64; ++primitiveCount)
+	{
+		testPrimitiveCount(random, primitiveCount);
+	}
+
+	const unsigned iterations = Harness::isQuick(argc, argv) ? 200 : 2000;
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		testPrimitiveCount(random, random.range(1, 5000));
+	}
+	return Harness::report("IndexTest");
+}
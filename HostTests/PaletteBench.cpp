@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <iterator>
+#include <vector>
+
+#include <DDraw/BlitterKernels.h>
+#include <Harness.h>
+
+namespace
+{
+	struct Resolution
+	{
+		DWORD width;
+		DWORD height;
+	};
+
+	const Resolution g_resolutions[] = {
+		{ 320, 200 }, { 640, 480 }, { 800, 600 }, { 1024, 768 }, { 1280, 1024 }, { 1920, 1080 }
+	};
+
+	// Dirty rect updates only convert the changed rows, e.g. a status bar or a single sprite row band
+	const DWORD g_dirtyRowDivisors[] = { 1, 8 };
+}
+
+int main(int argc, char* argv[])
+{
+	const bool isQuick = Harness::isQuick(argc, argv);
+	const double minSeconds = isQuick ? 0.0 : 0.05;
+	const Resolution* resolutionsEnd = isQuick ? g_resolutions + 2 : std::end(g_resolutions);
+
+	RGBQUAD palette[256] = {};
+	for (UINT i = 0; i < 256; ++i)
+	{
+		palette[i] = { static_cast<BYTE>(i), static_cast<BYTE>(i * 3), static_cast<BYTE>(i * 7), 0 };
+	}
+
+	std::printf("%-6s %3s %11s %6s %12s\n", "tier", "bpp", "size", "rows", "Mpixels/s");
+	for (int avx2 = 0; avx2 <= 1; ++avx2)
+	{
+		DDraw::BlitterKernels::enableAvx2(0 != avx2);
+		if (avx2 && !DDraw::BlitterKernels::isAvx2Enabled())
+		{
+			break;
+		}
+
+		for (DWORD bytesPerPixel = 2; bytesPerPixel <= 4; bytesPerPixel += 2)
+		{
+			for (const Resolution* res = g_resolutions; res != resolutionsEnd; ++res)
+			{
+				std::vector<BYTE> src(res->width * res->height);
+				std::vector<BYTE> dst(res->width * res->height * bytesPerPixel);
+				for (std::size_t i = 0; i < src.size(); ++i)
+				{
+					src[i] = static_cast<BYTE>(i * 31 + i / res->width);
+				}
+
+				for (DWORD divisor : g_dirtyRowDivisors)
+				{
+					const DWORD height = res->height / divisor;
+					const double seconds = Harness::measure([&]()
+						{
+							DDraw::BlitterKernels::expandPalette(dst.data(), res->width * bytesPerPixel,
+								src.data(), res->width, res->width, height, bytesPerPixel, palette);
+						}, minSeconds);
+					std::printf("%-6s %3u %5ux%-5u %6u %12.1f\n", avx2 ? "avx2" : "scalar", bytesPerPixel * 8,
+						res->width, res->height, height, res->width * height / seconds / 1e6);
+				}
+			}
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,80 @@
+#include <vector>
+
+#include <DDraw/BlitterKernels.h>
+#include <Harness.h>
+
+namespace
+{
+	const DWORD GUARD = 64;
+
+	DWORD toPixel(const RGBQUAD& color, DWORD bytesPerPixel)
+	{
+		if (4 == bytesPerPixel)
+		{
+			return (color.rgbReserved << 24) | (color.rgbRed << 16) | (color.rgbGreen << 8) | color.rgbBlue;
+		}
+		return ((color.rgbRed & 0xF8) << 8) | ((color.rgbGreen & 0xFC) << 3) | (color.rgbBlue >> 3);
+	}
+
+	void testExpandPalette(Harness::Random& random)
+	{
+		const DWORD bytesPerPixel = random.chance(50) ? 2 : 4;
+		const DWORD width = random.chance(20) ? random.range(1, 16) : random.range(1, 300);
+		const DWORD height = random.range(1, 12);
+		const DWORD srcPitch = width + random.range(0, 16);
+		const DWORD dstPitch = width * bytesPerPixel + random.range(0, 16);
+
+		RGBQUAD palette[256] = {};
+		for (auto& color : palette)
+		{
+			const uint32_t value = random.next();
+			std::memcpy(&color, &value, sizeof(color));
+		}
+
+		std::vector<BYTE> src(2 * GUARD + srcPitch * height);
+		std::vector<BYTE> dst(2 * GUARD + dstPitch * height);
+		for (auto& b : src)
+		{
+			b = static_cast<BYTE>(random.next());
+		}
+		for (auto& b : dst)
+		{
+			b = static_cast<BYTE>(random.next());
+		}
+
+		std::vector<BYTE> expected(dst);
+		for (DWORD y = 0; y < height; ++y)
+		{
+			for (DWORD x = 0; x < width; ++x)
+			{
+				const DWORD pixel = toPixel(palette[src[GUARD + y * srcPitch + x]], bytesPerPixel);
+				std::memcpy(&expected[GUARD + y * dstPitch + x * bytesPerPixel], &pixel, bytesPerPixel);
+			}
+		}
+
+		DDraw::BlitterKernels::expandPalette(dst.data() + GUARD, dstPitch, src.data() + GUARD, srcPitch,
+			width, height, bytesPerPixel, palette);
+		HARNESS_CHECK(dst == expected, "bpp %u, %ux%u, pitch %u/%u", bytesPerPixel * 8, width, height, dstPitch, srcPitch);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned iterations = Harness::isQuick(argc, argv) ? 2000 : 20000;
+	for (int avx2 = 0; avx2 <= 1; ++avx2)
+	{
+		DDraw::BlitterKernels::enableAvx2(0 != avx2);
+		if (avx2 && !DDraw::BlitterKernels::isAvx2Enabled())
+		{
+			std::printf("AVX2 is not supported, skipping the AVX2 tier\n");
+			break;
+		}
+
+		Harness::Random random(4321 + avx2);
+		for (unsigned i = 0; i < iterations; ++i)
+		{
+			testExpandPalette(random);
+		}
+	}
+	return Harness::report("PaletteTest");
+}
@@ -0,0 +1,153 @@
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include <D3dDdi/SpriteKernels.h>
+#include <Harness.h>
+
+namespace
+{
+	// Same layout as D3DTLVERTEX
+	const UINT Z_OFFSET = 8;
+	const UINT TEXCOORD_OFFSET = 24;
+	const UINT VERTEX_SIZE = 32;
+
+	float getFloat(const std::vector<BYTE>& vertices, UINT stride, UINT vertex, UINT offset)
+	{
+		float value = 0;
+		std::memcpy(&value, &vertices[vertex * stride + offset], sizeof(value));
+		return value;
+	}
+
+	void setFloat(std::vector<BYTE>& vertices, UINT stride, UINT vertex, UINT offset, float value)
+	{
+		std::memcpy(&vertices[vertex * stride + offset], &value, sizeof(value));
+	}
+
+	UINT getVertex(const std::vector<UINT16>& indices, UINT i)
+	{
+		return indices.empty() ? i : indices[i];
+	}
+
+	// Scalar reference of DrawPrimitive::isSprite for one triangle
+	bool isSpriteReference(const std::vector<BYTE>& vertices, UINT stride, const std::vector<UINT16>& indices,
+		UINT triangle, float maxZ)
+	{
+		const float z0 = getFloat(vertices, stride, getVertex(indices, triangle * 3), Z_OFFSET);
+		if (z0 > maxZ)
+		{
+			return false;
+		}
+		return z0 == getFloat(vertices, stride, getVertex(indices, triangle * 3 + 1), Z_OFFSET) &&
+			z0 == getFloat(vertices, stride, getVertex(indices, triangle * 3 + 2), Z_OFFSET);
+	}
+
+	// Scalar reference of the texture coordinate check in DrawPrimitive::setTextureClampMode
+	bool isTexCoordInRangeReference(const std::vector<BYTE>& vertices, UINT stride, const std::vector<UINT16>& indices,
+		UINT count, float minU, float maxU, float minV, float maxV)
+	{
+		for (UINT i = 0; i < count; ++i)
+		{
+			const UINT vertex = getVertex(indices, i);
+			const float u = getFloat(vertices, stride, vertex, TEXCOORD_OFFSET);
+			const float v = getFloat(vertices, stride, vertex, TEXCOORD_OFFSET + 4);
+			if (u < minU || u > maxU || v < minV || v > maxV)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	float getRandomZ(Harness::Random& random)
+	{
+		const float values[] = { 0.0f, 0.25f, 0.5f, 0.99f, 1.0f, std::numeric_limits<float>::quiet_NaN() };
+		return random.chance(90) ? values[random.range(0, 4)] : values[random.range(0, 5)];
+	}
+
+	float getRandomTexCoord(Harness::Random& random)
+	{
+		const float values[] = { -0.01f, -0.001f, 0.0f, 0.5f, 1.0f, 1.001f, 1.01f,
+			std::numeric_limits<float>::quiet_NaN() };
+		return random.chance(98) ? random.real(0, 1) : values[random.range(0, 7)];
+	}
+
+	void testSprites(Harness::Random& random)
+	{
+		const UINT triangleCount = random.chance(20) ? random.range(1, 8) : random.range(1, 300);
+		const UINT stride = VERTEX_SIZE + 4 * random.range(0, 4);
+		const UINT vertexCount = random.chance(50) ? triangleCount * 3 : random.range(1, 100);
+		std::vector<UINT16> indices;
+		if (vertexCount != triangleCount * 3)
+		{
+			indices.resize(triangleCount * 3);
+			for (auto& index : indices)
+			{
+				index = static_cast<UINT16>(random.range(0, vertexCount - 1));
+			}
+		}
+
+		// Most triangles are sprites with a shared z, sprite and non-sprite triangles come in runs
+		std::vector<BYTE> vertices(vertexCount * stride);
+		const float spriteZ = getRandomZ(random);
+		const UINT nonSpritePercent = random.range(0, 100);
+		for (UINT i = 0; i < vertexCount; ++i)
+		{
+			setFloat(vertices, stride, i, Z_OFFSET, random.chance(nonSpritePercent) ? getRandomZ(random) : spriteZ);
+			setFloat(vertices, stride, i, TEXCOORD_OFFSET, getRandomTexCoord(random));
+			setFloat(vertices, stride, i, TEXCOORD_OFFSET + 4, getRandomTexCoord(random));
+		}
+
+		const float maxZ = random.chance(50) ? std::numeric_limits<float>::infinity() : random.range(0, 100) / 100.0f;
+		std::vector<UINT> mask(D3dDdi::SpriteKernels::getMaskSize(triangleCount) + 1, 0xDEADBEEF);
+		D3dDdi::SpriteKernels::classifySprites(mask.data(), vertices.data() + Z_OFFSET, stride,
+			indices.empty() ? nullptr : indices.data(), triangleCount, maxZ);
+
+		for (UINT i = 0; i < triangleCount; ++i)
+		{
+			HARNESS_CHECK(D3dDdi::SpriteKernels::isSet(mask.data(), i) ==
+				isSpriteReference(vertices, stride, indices, i, maxZ),
+				"triangle %u of %u, stride %u, indexed %d, maxZ %f", i, triangleCount, stride, !indices.empty(), maxZ);
+		}
+		for (UINT i = triangleCount; i < D3dDdi::SpriteKernels::getMaskSize(triangleCount) * 32; ++i)
+		{
+			HARNESS_CHECK(!D3dDdi::SpriteKernels::isSet(mask.data(), i), "padding bit %u of %u", i, triangleCount);
+		}
+		HARNESS_CHECK(0xDEADBEEF == mask.back(), "mask overrun, %u triangles", triangleCount);
+
+		UINT expectedFirst = 0;
+		D3dDdi::SpriteKernels::forEachRun(mask.data(), triangleCount, [&](UINT first, UINT end, bool isSprite)
+			{
+				HARNESS_CHECK(first == expectedFirst && first < end && end <= triangleCount,
+					"run %u-%u, expected start %u, %u triangles", first, end, expectedFirst, triangleCount);
+				for (UINT i = first; i < end; ++i)
+				{
+					HARNESS_CHECK(isSpriteReference(vertices, stride, indices, i, maxZ) == isSprite,
+						"triangle %u in run %u-%u", i, first, end);
+				}
+				HARNESS_CHECK(end == triangleCount || isSpriteReference(vertices, stride, indices, end, maxZ) != isSprite,
+					"run %u-%u ends early", first, end);
+				expectedFirst = end;
+			});
+		HARNESS_CHECK(expectedFirst == triangleCount, "runs end at %u of %u", expectedFirst, triangleCount);
+
+		const UINT count = triangleCount * 3;
+		const float minU = -1.0f / 256;
+		const float minV = -1.0f / 128;
+		HARNESS_CHECK(D3dDdi::SpriteKernels::isTexCoordInRange(vertices.data() + TEXCOORD_OFFSET, stride,
+			indices.empty() ? nullptr : indices.data(), count, minU, 1 - minU, minV, 1 - minV) ==
+			isTexCoordInRangeReference(vertices, stride, indices, count, minU, 1 - minU, minV, 1 - minV),
+			"texcoord range, %u vertices, stride %u, indexed %d", count, stride, !indices.empty());
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned iterations = Harness::isQuick(argc, argv) ? 2000 : 20000;
+	Harness::Random random(2468);
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		testSprites(random);
+	}
+	return Harness::report("SpriteTest");
+}
@@ -0,0 +1,56 @@
+#include <climits>
+
+#include <DDraw/UpdateThreadPolicy.h>
+#include <Harness.h>
+
+namespace
+{
+	using namespace DDraw::UpdateThreadPolicy;
+
+	const char* getName(Wait wait)
+	{
+		switch (wait)
+		{
+		case WAIT_EVENT:
+			return "event";
+		case WAIT_TIMEOUT:
+			return "timeout";
+		case WAIT_VSYNC:
+			return "vsync";
+		}
+		return "?";
+	}
+
+	void check(int msUntilUpdateReady, bool isUpdateQueued, Wait expected)
+	{
+		const Wait wait = getWait(msUntilUpdateReady, isUpdateQueued);
+		HARNESS_CHECK(wait == expected, "msUntilUpdateReady %d, queued %d: %s instead of %s",
+			msUntilUpdateReady, isUpdateQueued, getName(wait), getName(expected));
+	}
+}
+
+int main(int /*argc*/, char* /*argv*/[])
+{
+	// RealPrimarySurface::flush returns -1 when nothing is ready or the last present has not ended yet
+	check(-1, false, WAIT_EVENT);
+	check(-1, true, WAIT_VSYNC);
+
+	// An update or delayed flip that becomes ready later is waited for with a timeout,
+	// which a new update or flip can cut short through the event
+	for (int ms : { 1, 3, 10, INT_MAX })
+	{
+		check(ms, false, WAIT_TIMEOUT);
+		check(ms, true, WAIT_TIMEOUT);
+	}
+
+	// Presented with nothing queued: only an event can start the next update
+	check(0, false, WAIT_EVENT);
+	check(INT_MIN, false, WAIT_EVENT);
+
+	// Queued while the previous present is still on screen: wait for its vsync instead of the event,
+	// so that an update is never left waiting for a signal that was already consumed
+	check(0, true, WAIT_VSYNC);
+	check(INT_MIN, true, WAIT_VSYNC);
+
+	return Harness::report("UpdateThreadPolicyTest");
+}
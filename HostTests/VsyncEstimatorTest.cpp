@@ -0,0 +1,138 @@
+#include <cmath>
+
+#include <Common/VsyncEstimator.h>
+#include <Harness.h>
+
+namespace
+{
+	// Typical QueryPerformanceFrequency on current Windows versions
+	const double QPC_FREQUENCY = 10000000;
+
+	// Generates vsync timestamps of a display with the given refresh rate, with optional scheduling jitter
+	// and vsyncs that are not reported to the estimator
+	class VsyncStream
+	{
+	public:
+		VsyncStream(Harness::Random& random, double refreshRate, double jitterFraction, unsigned missedPercent)
+			: m_random(random)
+			, m_period(QPC_FREQUENCY / refreshRate)
+			, m_jitter(jitterFraction * m_period)
+			, m_missedPercent(missedPercent)
+			, m_next(QPC_FREQUENCY)
+		{
+		}
+
+		double getPeriod() const { return m_period; }
+		double getNextVsync() const { return m_next; }
+
+		long long nextSample()
+		{
+			while (m_random.chance(m_missedPercent))
+			{
+				m_next += m_period;
+			}
+			const double vsync = m_next;
+			m_next += m_period;
+			return static_cast<long long>(vsync + m_random.real(-1, 1) * m_jitter);
+		}
+
+		void setRefreshRate(double refreshRate)
+		{
+			const double period = QPC_FREQUENCY / refreshRate;
+			m_next += period - m_period;
+			m_period = period;
+		}
+
+	private:
+		Harness::Random& m_random;
+		double m_period;
+		double m_jitter;
+		unsigned m_missedPercent;
+		double m_next;
+	};
+
+	void checkPrediction(const VsyncEstimator& estimator, VsyncStream& stream, Harness::Random& random,
+		double tolerance, const char* name)
+	{
+		const double period = stream.getPeriod();
+		HARNESS_CHECK(std::abs(estimator.getPeriod() - period) <= period * 0.005,
+			"%s: period %lld, expected %.0f", name, estimator.getPeriod(), period);
+
+		// Query at a random time within the frame before the next real vsync
+		const double next = stream.getNextVsync();
+		const double now = next - period * random.real(0.1f, 0.9f);
+		const long long predicted = estimator.getNextVsync(static_cast<long long>(now));
+		HARNESS_CHECK(std::abs(predicted - next) <= tolerance * period,
+			"%s: next vsync %lld, expected %.0f (%.1f%% of a period off)", name, predicted, next,
+			100 * std::abs(predicted - next) / period);
+	}
+
+	void testSteady(Harness::Random& random, unsigned missedPercent, const char* name)
+	{
+		const double jitter = 0.02;
+		VsyncStream stream(random, 60, jitter, missedPercent);
+		VsyncEstimator estimator;
+		HARNESS_CHECK(0 == estimator.getNextVsync(0), "%s: prediction without samples", name);
+
+		for (unsigned i = 0; i < 100; ++i)
+		{
+			estimator.addVsync(stream.nextSample());
+		}
+
+		for (unsigned i = 0; i < 500; ++i)
+		{
+			estimator.addVsync(stream.nextSample());
+			checkPrediction(estimator, stream, random, 2 * jitter, name);
+		}
+	}
+
+	void testRefreshRateChange(Harness::Random& random)
+	{
+		const char* name = "refresh rate change";
+		const double jitter = 0.02;
+		VsyncStream stream(random, 60, jitter, 0);
+		VsyncEstimator estimator;
+		for (unsigned i = 0; i < 200; ++i)
+		{
+			estimator.addVsync(stream.nextSample());
+		}
+		const long long oldPeriod = estimator.getPeriod();
+
+		// 100 Hz vsyncs are too far off the 60 Hz timeline, so they are ignored until MAX_OUTLIERS of them
+		// arrive in a row. The estimation then restarts from the last one.
+		stream.setRefreshRate(100);
+		for (unsigned i = 1; i < VsyncEstimator::MAX_OUTLIERS; ++i)
+		{
+			estimator.addVsync(stream.nextSample());
+			HARNESS_CHECK(oldPeriod == estimator.getPeriod(), "%s: period changed to %lld by outlier %u",
+				name, estimator.getPeriod(), i);
+		}
+
+		estimator.addVsync(stream.nextSample());
+		HARNESS_CHECK(0 == estimator.getPeriod(), "%s: no reset after %u outliers, period %lld",
+			name, VsyncEstimator::MAX_OUTLIERS, estimator.getPeriod());
+
+		for (unsigned i = 0; i < 300; ++i)
+		{
+			estimator.addVsync(stream.nextSample());
+		}
+		for (unsigned i = 0; i < 100; ++i)
+		{
+			estimator.addVsync(stream.nextSample());
+			checkPrediction(estimator, stream, random, 2 * jitter, name);
+		}
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	const unsigned iterations = Harness::isQuick(argc, argv) ? 20 : 200;
+	Harness::Random random(1357);
+	for (unsigned i = 0; i < iterations; ++i)
+	{
+		testSteady(random, 0, "steady 60 Hz");
+		testSteady(random, 10, "missed vsyncs");
+		testRefreshRateChange(random);
+	}
+	return Harness::report("VsyncEstimatorTest");
+}